@@ -0,0 +1,120 @@
+#include "Benchmark.h"
+#include "FlatHash.h"
+#include <unordered_set>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+
+constexpr size_t LOOKUPS_COUNT = 1 << 22;
+constexpr uint64_t MISS_OFFSET = 1ull << 20; // shifts position in line past any real line length
+
+struct XorPairHash { // hash used by graph.h before mixing
+	size_t operator()(const std::pair<int, int>& v) const {
+		std::hash<int> int_hasher;
+		return int_hasher(v.first) ^ int_hasher(v.second);
+	}
+};
+
+struct MixedPairHash {
+	size_t operator()(const std::pair<int, int>& v) const {
+		return MixHash(v.first, v.second);
+	}
+};
+
+struct MixedHash {
+	size_t operator()(uint64_t v) const {
+		return MixHash(v);
+	}
+};
+
+static uint64_t PackEdge(const std::pair<int, int>& edge) {
+	return static_cast<uint64_t>(static_cast<uint32_t>(edge.first)) << 32 | static_cast<uint32_t>(edge.second);
+}
+
+template <typename Set>
+static void PrintDistribution(const char* name, const Set& set, std::ostream& out) {
+	size_t used = 0;
+	size_t longest = 0;
+	for (size_t i = 0; i < set.bucket_count(); ++i) {
+		size_t size = set.bucket_size(i);
+		used += size != 0;
+		longest = std::max(longest, size);
+	}
+	double buckets = static_cast<double>(set.bucket_count());
+	double keys = static_cast<double>(set.size());
+	double expectedUsed = buckets * (1.0 - std::pow(1.0 - 1.0 / buckets, keys)); // for uniformly random hash
+	out << name << ": " << set.size() << " keys, " << set.bucket_count() << " buckets, " << set.size() - used << " collisions (uniform " << std::llround(keys - expectedUsed) << "), longest chain " << longest << std::endl;
+}
+
+static void PrintProbes(const char* name, const FlatHashSet& set, std::ostream& out) {
+	size_t total = 0;
+	size_t longest = 0;
+	for (uint64_t key : set) {
+		size_t length = set.ProbeLength(key);
+		total += length;
+		longest = std::max(longest, length);
+	}
+	out << name << ": " << set.Size() << " keys, " << set.Capacity() << " slots, " << static_cast<double>(total) / std::max<size_t>(set.Size(), 1) << " probes per hit, longest " << longest << std::endl;
+}
+
+template <typename Lookup>
+static void PrintThroughput(const char* name, const std::vector<uint64_t>& queries, Lookup lookup, std::ostream& out) {
+	size_t found = 0;
+	auto before = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < LOOKUPS_COUNT; ++i) {
+		found += lookup(queries[i % queries.size()]);
+	}
+	auto after = std::chrono::high_resolution_clock::now();
+	double ns = std::chrono::duration<double, std::nano>(after - before).count();
+	out << name << ": " << ns / LOOKUPS_COUNT << " ns per lookup, " << found << " hits" << std::endl;
+}
+
+void RunHashBenchmark(const std::vector<std::pair<int, int>>& edges, const std::vector<uint64_t>& positions, std::ostream& out) {
+	out << std::fixed << std::setprecision(2);
+
+	std::unordered_set<std::pair<int, int>, XorPairHash> xorEdges{ edges.begin(), edges.end() };
+	std::unordered_set<std::pair<int, int>, MixedPairHash> mixedEdges{ edges.begin(), edges.end() };
+	std::unordered_set<uint64_t> stdPositions{ positions.begin(), positions.end() };
+	std::unordered_set<uint64_t, MixedHash> mixedPositions{ positions.begin(), positions.end() };
+	FlatHashSet flatEdges(edges.size());
+	std::vector<uint64_t> edgeQueries;
+	for (const auto& edge : edges) {
+		flatEdges.Insert(PackEdge(edge));
+		edgeQueries.push_back(PackEdge(edge));
+		edgeQueries.push_back(PackEdge({ edge.first, edge.first })); // self loops are never present
+	}
+	FlatHashSet flatPositions(positions.size());
+	std::vector<uint64_t> positionQueries;
+	for (uint64_t position : positions) {
+		flatPositions.Insert(position);
+		positionQueries.push_back(position);
+		positionQueries.push_back(position + MISS_OFFSET);
+	}
+	if (edgeQueries.empty() || positionQueries.empty()) {
+		return;
+	}
+
+	PrintDistribution("edges, xor hash", xorEdges, out);
+	PrintDistribution("edges, mixed hash", mixedEdges, out);
+	PrintDistribution("positions, std::hash", stdPositions, out);
+	PrintDistribution("positions, mixed hash", mixedPositions, out);
+	PrintProbes("edges, flat set", flatEdges, out);
+	PrintProbes("positions, flat set", flatPositions, out);
+
+	PrintThroughput("edges, xor unordered_set", edgeQueries, [&](uint64_t key) {
+		return xorEdges.count({ static_cast<int>(key >> 32), static_cast<int>(key & 0xffffffffu) }) != 0;
+	}, out);
+	PrintThroughput("edges, mixed unordered_set", edgeQueries, [&](uint64_t key) {
+		return mixedEdges.count({ static_cast<int>(key >> 32), static_cast<int>(key & 0xffffffffu) }) != 0;
+	}, out);
+	PrintThroughput("edges, flat set", edgeQueries, [&](uint64_t key) {
+		return flatEdges.Contains(key);
+	}, out);
+	PrintThroughput("positions, unordered_set", positionQueries, [&](uint64_t key) {
+		return stdPositions.count(key) != 0;
+	}, out);
+	PrintThroughput("positions, flat set", positionQueries, [&](uint64_t key) {
+		return flatPositions.Contains(key);
+	}, out);
+}
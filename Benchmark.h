@@ -0,0 +1,8 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <ostream>
+#include <utility>
+
+// prints bucket distribution of old xor and mixed hashes and lookup speed of std::unordered_set and FlatHashSet
+void RunHashBenchmark(const std::vector<std::pair<int, int>>& edges, const std::vector<uint64_t>& positions, std::ostream& out);
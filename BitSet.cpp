@@ -0,0 +1,119 @@
+#include "BitSet.h"
+#include <bitset>
+#include <algorithm>
+
+static size_t PopCount(uint64_t word) {
+	return std::bitset<64>(word).count();
+}
+
+static size_t LowestBit(uint64_t word) { // word must not be 0
+	return PopCount((word & (~word + 1)) - 1);
+}
+
+BitSet::Iterator::Iterator(const BitSet& set, size_t idx) : set{ set }, idx{ idx } {}
+
+int BitSet::Iterator::operator*() const {
+	return static_cast<int>(idx);
+}
+
+BitSet::Iterator& BitSet::Iterator::operator++() {
+	idx = set.FindNext(idx + 1);
+	return *this;
+}
+
+bool BitSet::Iterator::operator!=(const Iterator& other) const {
+	return idx != other.idx;
+}
+
+BitSet::BitSet(size_t size) : words((size + 63) / 64, 0), size{ size } {}
+
+void BitSet::Resize(size_t newSize) {
+	words.resize((newSize + 63) / 64, 0);
+	size = newSize;
+	if (size % 64 != 0) {
+		words.back() &= (1ull << (size % 64)) - 1;
+	}
+}
+
+size_t BitSet::Size() const {
+	return size;
+}
+
+bool BitSet::Contains(int idx) const {
+	return idx >= 0 && static_cast<size_t>(idx) < size && (words[idx / 64] >> (idx % 64) & 1) != 0;
+}
+
+void BitSet::Insert(int idx) {
+	words[idx / 64] |= 1ull << (idx % 64);
+}
+
+void BitSet::Erase(int idx) {
+	if (idx >= 0 && static_cast<size_t>(idx) < size) {
+		words[idx / 64] &= ~(1ull << (idx % 64));
+	}
+}
+
+void BitSet::Clear() {
+	std::fill(words.begin(), words.end(), 0);
+}
+
+bool BitSet::Empty() const {
+	for (uint64_t word : words) {
+		if (word != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+size_t BitSet::Count() const {
+	size_t result = 0;
+	for (uint64_t word : words) {
+		result += PopCount(word);
+	}
+	return result;
+}
+
+BitSet& BitSet::operator|=(const BitSet& other) {
+	if (size < other.size) {
+		Resize(other.size);
+	}
+	for (size_t i = 0; i < other.words.size(); ++i) {
+		words[i] |= other.words[i];
+	}
+	return *this;
+}
+
+BitSet& BitSet::Subtract(const BitSet& other) {
+	for (size_t i = 0; i < words.size() && i < other.words.size(); ++i) {
+		words[i] &= ~other.words[i];
+	}
+	return *this;
+}
+
+bool BitSet::operator==(const BitSet& other) const {
+	return size == other.size && words == other.words;
+}
+
+BitSet::Iterator BitSet::begin() const {
+	return Iterator(*this, FindNext(0));
+}
+
+BitSet::Iterator BitSet::end() const {
+	return Iterator(*this, size);
+}
+
+size_t BitSet::FindNext(size_t idx) const {
+	if (idx >= size) {
+		return size;
+	}
+	size_t wordIdx = idx / 64;
+	uint64_t word = words[wordIdx] & (~0ull << (idx % 64));
+	while (word == 0) {
+		if (++wordIdx == words.size()) {
+			return size;
+		}
+		word = words[wordIdx];
+	}
+	return wordIdx * 64 + LowestBit(word);
+}
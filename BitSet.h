@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class BitSet { // dense set of non-negative integers below Size(), bits past the end read as unset
+public:
+	class Iterator { // walks set bits in ascending order
+	public:
+		Iterator(const BitSet& set, size_t idx);
+		int operator*() const;
+		Iterator& operator++();
+		bool operator!=(const Iterator& other) const;
+	private:
+		const BitSet& set;
+		size_t idx;
+	};
+	BitSet() = default;
+	explicit BitSet(size_t size);
+	void Resize(size_t size); // keeps bits below new size
+	size_t Size() const;
+	bool Contains(int idx) const;
+	void Insert(int idx); // idx must be below Size()
+	void Erase(int idx);
+	void Clear(); // keeps size
+	bool Empty() const;
+	size_t Count() const;
+	BitSet& operator|=(const BitSet& other); // grows to other's size if needed
+	BitSet& Subtract(const BitSet& other);
+	bool operator==(const BitSet& other) const; // same size and bits
+	Iterator begin() const;
+	Iterator end() const;
+private:
+	size_t FindNext(size_t idx) const; // first set bit not less than idx, Size() if none
+	std::vector<uint64_t> words;
+	size_t size = 0;
+};
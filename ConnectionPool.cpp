@@ -0,0 +1,71 @@
+#include "ConnectionPool.h"
+#include <iostream>
+
+constexpr size_t REQUESTS_CAPACITY = 256;
+
+ConnectionPool::ConnectionPool(const std::string& login, const std::string& password, const std::string& gameName) :
+		login{ login }, password{ password }, gameName{ gameName }, requests{ REQUESTS_CAPACITY } {}
+
+ConnectionPool::~ConnectionPool() {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& worker : workers) {
+		worker->thread.join();
+	}
+}
+
+void ConnectionPool::Reserve(size_t workersCount) {
+	while (workers.size() < workersCount) {
+		workers.push_back(std::make_unique<Worker>(login, password, gameName));
+		Worker& worker = *workers.back();
+		worker.thread = std::thread{ &ConnectionPool::Work, this, std::ref(worker.connection) };
+	}
+}
+
+void ConnectionPool::MoveTrain(size_t lineIdx, int speed, size_t trainIdx) {
+	++unfinished;
+	while (!requests.TryPush({ lineIdx, speed, trainIdx })) {
+		std::this_thread::yield(); // full, workers are draining it
+	}
+	++queued;
+	{
+		std::lock_guard<std::mutex> guard(lock); // worker can't miss notification between its check and wait
+	}
+	wake.notify_one();
+}
+
+void ConnectionPool::Wait() {
+	std::unique_lock<std::mutex> guard(lock);
+	done.wait(guard, [this]() { return unfinished == 0; });
+}
+
+void ConnectionPool::Work(ServerConnection& connection) {
+	MoveRequest request;
+	while (true) {
+		if (!requests.TryPop(request)) {
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait(guard, [this]() { return queued != 0 || stopping; });
+			if (queued == 0) {
+				return;
+			}
+			continue;
+		}
+		--queued;
+		try {
+			if (!connection.IsEstablished()) {
+				connection.Establish();
+			}
+			connection.MoveTrain(request.lineIdx, request.speed, request.trainIdx);
+		}
+		catch (std::runtime_error& error) {
+			std::cout << error.what() << std::endl;
+		}
+		if (--unfinished == 0) {
+			std::lock_guard<std::mutex> guard(lock);
+			done.notify_all();
+		}
+	}
+}
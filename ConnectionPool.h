@@ -0,0 +1,41 @@
+#pragma once
+#include "ServerConnection.h"
+#include "LockFreeQueue.h"
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class ConnectionPool { // persistent workers sending MOVE requests in parallel, each over own helper connection of the player
+public:
+	ConnectionPool(const std::string& login, const std::string& password, const std::string& gameName);
+	ConnectionPool(const ConnectionPool&) = delete;
+	ConnectionPool& operator=(const ConnectionPool&) = delete;
+	~ConnectionPool(); // sends queued requests, then closes helper connections
+	void Reserve(size_t workersCount); // starts missing workers, their connections are established by first request
+	void MoveTrain(size_t lineIdx, int speed, size_t trainIdx); // queued for the first idle worker
+	void Wait(); // returns when every queued request is answered
+private:
+	struct MoveRequest {
+		size_t lineIdx;
+		int speed;
+		size_t trainIdx;
+	};
+	struct Worker {
+		ServerConnection connection;
+		std::thread thread;
+		Worker(const std::string& login, const std::string& password, const std::string& gameName) : connection{ login, password, gameName, false, false } {}
+	};
+	void Work(ServerConnection& connection);
+	std::string login;
+	std::string password;
+	std::string gameName;
+	std::vector<std::unique_ptr<Worker>> workers;
+	LockFreeQueue<MoveRequest> requests;
+	std::atomic<size_t> queued{ 0 }; // pushed and not yet popped
+	std::atomic<size_t> unfinished{ 0 }; // pushed and not yet answered
+	std::mutex lock; // only for sleeping on wake and done
+	std::condition_variable wake;
+	std::condition_variable done;
+	bool stopping = false;
+};
@@ -0,0 +1,166 @@
+#include "FlatHash.h"
+#include <algorithm>
+#include <stdexcept>
+
+constexpr size_t MIN_CAPACITY = 16;
+
+FlatHashSet::Iterator::Iterator(const FlatHashSet& set, size_t slot) : set{ set }, slot{ set.SkipEmpty(slot) } {}
+
+uint64_t FlatHashSet::Iterator::operator*() const {
+	return set.keys[slot];
+}
+
+FlatHashSet::Iterator& FlatHashSet::Iterator::operator++() {
+	slot = set.SkipEmpty(slot + 1);
+	return *this;
+}
+
+bool FlatHashSet::Iterator::operator!=(const Iterator& other) const {
+	return slot != other.slot;
+}
+
+FlatHashSet::FlatHashSet(size_t expectedCount) {
+	Reserve(expectedCount);
+}
+
+bool FlatHashSet::Contains(uint64_t key) const {
+	if (keys.empty()) {
+		return false;
+	}
+	return keys[FindSlot(key)] == key;
+}
+
+bool FlatHashSet::Insert(uint64_t key) {
+	if (key == EMPTY) {
+		throw std::runtime_error{ "reserved key in FlatHashSet" };
+	}
+	if ((count + 1) * 2 > keys.size()) { // load factor never exceeds one half
+		Rehash(std::max(MIN_CAPACITY, keys.size() * 2));
+	}
+	size_t slot = FindSlot(key);
+	if (keys[slot] == key) {
+		return false;
+	}
+	keys[slot] = key;
+	++count;
+	return true;
+}
+
+bool FlatHashSet::Erase(uint64_t key) {
+	if (keys.empty()) {
+		return false;
+	}
+	size_t mask = keys.size() - 1;
+	size_t slot = FindSlot(key);
+	if (keys[slot] != key) {
+		return false;
+	}
+	// backward shift: move later keys of the probe run into the hole so lookups never need tombstones
+	for (size_t next = (slot + 1) & mask; keys[next] != EMPTY; next = (next + 1) & mask) {
+		size_t home = MixHash(keys[next]) & mask;
+		if (((next - home) & mask) >= ((next - slot) & mask)) {
+			keys[slot] = keys[next];
+			slot = next;
+		}
+	}
+	keys[slot] = EMPTY;
+	--count;
+	return true;
+}
+
+void FlatHashSet::Clear() {
+	if (count != 0) {
+		std::fill(keys.begin(), keys.end(), EMPTY);
+		count = 0;
+	}
+}
+
+void FlatHashSet::Reserve(size_t expectedCount) {
+	size_t capacity = MIN_CAPACITY;
+	while (capacity < expectedCount * 2) {
+		capacity *= 2;
+	}
+	if (capacity > keys.size()) {
+		Rehash(capacity);
+	}
+}
+
+size_t FlatHashSet::Size() const {
+	return count;
+}
+
+bool FlatHashSet::Empty() const {
+	return count == 0;
+}
+
+size_t FlatHashSet::Capacity() const {
+	return keys.size();
+}
+
+size_t FlatHashSet::ProbeLength(uint64_t key) const {
+	if (keys.empty()) {
+		return 0;
+	}
+	size_t mask = keys.size() - 1;
+	size_t length = 1;
+	for (size_t i = MixHash(key) & mask; keys[i] != key && keys[i] != EMPTY; i = (i + 1) & mask) {
+		++length;
+	}
+	return length;
+}
+
+bool FlatHashSet::ContainsAdded(const FlatHashSet& before, const FlatHashSet& after) const {
+	for (uint64_t key : after) {
+		if (!before.Contains(key) && Contains(key)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void FlatHashSet::ApplyChanges(const FlatHashSet& before, const FlatHashSet& after) {
+	for (uint64_t key : before) {
+		if (!after.Contains(key)) {
+			Erase(key);
+		}
+	}
+	for (uint64_t key : after) {
+		if (!before.Contains(key)) {
+			Insert(key);
+		}
+	}
+}
+
+FlatHashSet::Iterator FlatHashSet::begin() const {
+	return Iterator{ *this, 0 };
+}
+
+FlatHashSet::Iterator FlatHashSet::end() const {
+	return Iterator{ *this, keys.size() };
+}
+
+size_t FlatHashSet::FindSlot(uint64_t key) const {
+	size_t mask = keys.size() - 1;
+	size_t i = MixHash(key) & mask;
+	while (keys[i] != key && keys[i] != EMPTY) {
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+size_t FlatHashSet::SkipEmpty(size_t slot) const {
+	while (slot < keys.size() && keys[slot] == EMPTY) {
+		++slot;
+	}
+	return slot;
+}
+
+void FlatHashSet::Rehash(size_t capacity) {
+	std::vector<uint64_t> old(capacity, EMPTY);
+	old.swap(keys);
+	for (uint64_t key : old) {
+		if (key != EMPTY) {
+			keys[FindSlot(key)] = key;
+		}
+	}
+}
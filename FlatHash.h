@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+inline size_t MixHash(uint64_t value) { // splitmix64 finalizer, every input bit affects every output bit
+	value += 0x9e3779b97f4a7c15ull;
+	value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+	value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+	return static_cast<size_t>(value ^ (value >> 31));
+}
+
+inline size_t MixHash(int first, int second) { // ordered pair, (a, b) and (b, a) hash differently
+	return MixHash(static_cast<uint64_t>(static_cast<uint32_t>(first)) << 32 | static_cast<uint32_t>(second));
+}
+
+class FlatHashSet { // open addressing set of 64-bit keys with linear probing, key ~0 is reserved
+public:
+	class Iterator { // walks keys in table order
+	public:
+		Iterator(const FlatHashSet& set, size_t slot);
+		uint64_t operator*() const;
+		Iterator& operator++();
+		bool operator!=(const Iterator& other) const;
+	private:
+		const FlatHashSet& set;
+		size_t slot;
+	};
+	FlatHashSet() = default;
+	explicit FlatHashSet(size_t expectedCount);
+	bool Contains(uint64_t key) const;
+	bool Insert(uint64_t key); // false if key is already present
+	bool Erase(uint64_t key); // false if key is absent
+	void Clear(); // keeps capacity
+	void Reserve(size_t expectedCount);
+	size_t Size() const;
+	bool Empty() const;
+	size_t Capacity() const;
+	size_t ProbeLength(uint64_t key) const; // slots inspected by lookup of key
+	bool ContainsAdded(const FlatHashSet& before, const FlatHashSet& after) const; // true if some key of after missing in before is present
+	void ApplyChanges(const FlatHashSet& before, const FlatHashSet& after); // erases keys removed and inserts keys added between before and after
+	Iterator begin() const;
+	Iterator end() const;
+private:
+	static constexpr uint64_t EMPTY = ~0ull;
+	size_t FindSlot(uint64_t key) const; // slot holding key or empty slot where probing stopped
+	size_t SkipEmpty(size_t slot) const;
+	void Rehash(size_t capacity);
+	std::vector<uint64_t> keys; // power of two size, EMPTY marks free slot
+	size_t count = 0;
+};
@@ -1,35 +1,56 @@
 #include "GameWorld.h"
 #include "json.h"
-#include <sstream>
+#include "Benchmark.h"
 #include <algorithm>
-#include <unordered_set>
+#include <numeric>
+#include <queue>
+#include <limits>
 
 #define NO_BUG_COLLISION
 
+#define COOPERATIVE_PATHFINDING
+
+#define PARALLEL_PLANNING
+
+#define PIPELINED_REQUESTS
+
+#define SPECULATIVE_PLANNING
+
+//#define HASH_BENCHMARK
+
+//#define SCORE_BENCHMARK
+
 #define PATHFINDING_DEBUG
 
 #ifdef _DEBUG
 #ifdef PATHFINDING_DEBUG
 #define _PATHFINDING_DEBUG
+#undef PARALLEL_PLANNING // keeps debug output of trains in order
 #endif
 #endif
 
-void makeMoveRequest(int lineIdx, int speed, int trainIdx, ServerConnection& connection) {
-	try {
-		if (!connection.IsEstablished()) {
-			connection.Establish();
-		}
-		connection.MoveTrain(lineIdx, speed, trainIdx);
-	}
-	catch (std::runtime_error& error) {
-		std::cout << error.what() << std::endl;
-	}
-}
+#if !defined(PARALLEL_PLANNING) || !defined(PIPELINED_REQUESTS)
+#undef SPECULATIVE_PLANNING // proposals are merged like parallel ones, planned while pipelined turn is answered
+#endif
+
+constexpr int COOPERATIVE_WINDOW = 8; // ticks planned ahead by cooperative search
 
 GameWorld::GameWorld(const std::string& playerName, const std::string& gameName, int playerCount, int numTurns, TextureManager& textureManager) : 
-		connection{ playerName, playerCount, gameName, numTurns }, textureManager { textureManager },
-		map{ connection.GetMapStaticObjects(), connection.GetMapCoordinates(), connection.GetMapDynamicObjects(), textureManager } {
+		connection{ playerName, playerCount, gameName, numTurns }, movePool{ connection.GetLogin(), connection.GetPassword(), connection.GetGameName() }, textureManager { textureManager },
+		map{ connection.GetMapStaticObjects(), connection.GetMapCoordinates(), connection.GetMapDynamicObjects(), textureManager },
+		edgesBlackList{ map.MakeEdgeSet() }, pointBlackList{ map.MakeVertexSet() } {
+	planning.takenPosts = map.MakeVertexSet();
+	playerOwner = InternOwner(connection.GetPlayerIdx());
+	for (int i : map.GetTowns()) {
+		whitePositions.Insert(GetPosition(i));
+	}
 	Update(connection.GetMapDynamicObjects());
+#ifdef HASH_BENCHMARK
+	BenchmarkHashes();
+#endif
+#ifdef SCORE_BENCHMARK
+	BenchmarkScores();
+#endif
 }
 
 double GameWorld::GetScore() {
@@ -42,20 +63,58 @@ double GameWorld::GetScore() {
 }
 
 void GameWorld::Update() {
+#ifdef PIPELINED_REQUESTS
+	if (turnResponses.valid()) {
+#ifdef SPECULATIVE_PLANNING
+		PlanNextTurn(); // while the server answers
+#endif
+		Update(FinishTurn());
+		return;
+	}
+#endif
 	Update(connection.GetMapDynamicObjects());
 }
 
+std::string GameWorld::FinishTurn() {
+	std::vector<ServerConnection::Response> responses;
+	try {
+		responses = turnResponses.get();
+	}
+	catch (...) {
+		spentArmor = spentBeforeTurn;
+		--gameTick;
+		throw;
+	}
+	const auto& turn = responses[responses.size() - 2];
+	const auto& layer = responses.back();
+	for (size_t i = 0; i + 2 < responses.size(); ++i) {
+		if (responses[i].result != ServerConnection::Result::OKEY) {
+			std::cout << responses[i].data << std::endl;
+		}
+	}
+	if (upgradeSent && responses.front().result != ServerConnection::Result::OKEY) {
+		spentArmor = spentBeforeTurn;
+	}
+	if (turn.result != ServerConnection::Result::OKEY) {
+		spentArmor = spentBeforeTurn;
+		--gameTick;
+		throw std::runtime_error{ turn.data };
+	}
+	if (layer.result != ServerConnection::Result::OKEY) {
+		throw std::runtime_error{ layer.data };
+	}
+	return layer.data;
+}
+
 void GameWorld::Draw(SdlWindow& window) {
-	map.Draw(window);
-	DrawTrains(window);
+	const RenderState& state = renderStates.GetFront();
+	map.DrawEdges(window);
+	map.DrawPosts(window, state.posts);
+	DrawTrains(window, state.trains);
 }
 
 void GameWorld::MakeMove() {
-	takenPosts.clear();
 	++gameTick;
-	for (const auto& [idx, target] : trainsTargets) {
-		takenPosts.insert(target);
-	}
 	int armor = map.GetArmor(map.TranslateVertexIdx(connection.GetHomeIdx()));
 	auto town = GetPosition(map.TranslateVertexIdx(connection.GetHomeIdx()));
 	std::vector<size_t> trainsToUpgrade;
@@ -97,6 +156,30 @@ void GameWorld::MakeMove() {
 		}
 	}
 	
+#ifdef PIPELINED_REQUESTS
+	// upgrade, moves, end of turn and next layer 1 are written at once over main connection,
+	// Update collects answers, so MakeMove returns without waiting for the turn
+	ServerConnection::Batch requests;
+	upgradeSent = !trainsToUpgrade.empty() || !townsToUpgrade.empty();
+	spentBeforeTurn = prevSpent;
+	if (upgradeSent) {
+		requests.Upgrade(townsToUpgrade, trainsToUpgrade);
+	}
+	try {
+		turnMoves = MoveTrains();
+		for (const auto& [lineIdx, speed, trainIdx] : turnMoves) {
+			requests.MoveTrain(lineIdx, speed, trainIdx);
+		}
+	}
+	catch (...) {
+		spentArmor = prevSpent;
+		--gameTick;
+		throw;
+	}
+	requests.EndTurn();
+	requests.GetMapDynamicObjects();
+	turnResponses = connection.SendAsync(std::move(requests));
+#else
 	if (!trainsToUpgrade.empty() || !townsToUpgrade.empty()) {
 		try {
 			connection.Upgrade(townsToUpgrade, trainsToUpgrade);
@@ -109,7 +192,12 @@ void GameWorld::MakeMove() {
 	}
 
 	try {
-		MoveTrains();
+		auto moves = MoveTrains();
+		movePool.Reserve(moves.size());
+		for (const auto& [lineIdx, speed, trainIdx] : moves) {
+			movePool.MoveTrain(lineIdx, speed, trainIdx);
+		}
+		movePool.Wait();
 		connection.EndTurn();
 	}
 	catch (...) {
@@ -117,18 +205,53 @@ void GameWorld::MakeMove() {
 		--gameTick;
 		throw;
 	}
+#endif
 }
 
 void GameWorld::Update(const std::string& jsonData) {
-	map.Update(jsonData);
-	whitePositions.clear();
-	for (int i : map.GetTowns()) {
-		whitePositions.insert(GetPosition(i));
+	changes.Clear();
+	Json::Reader reader(jsonData);
+	reader.ReadDict([&](std::string_view key) {
+		if (key == "posts") {
+			map.UpdatePosts(reader, changes.posts);
+		}
+		else if (key == "trains") {
+			UpdateTrains(reader);
+		}
+		else {
+			reader.Skip();
+		}
+	});
+	// black lists depend only on where trains are
+	if (changes.trainsMoved) {
+		edgesBlackList.Clear();
+		pointBlackList.Clear();
+		for (const auto& train : trains) {
+			BlackListTrain(train);
+		}
 	}
-	UpdateTrains(jsonData);
+	planning.takenPositions.Clear(); // planning adds its moves to taken positions
+	for (const auto& train : trains) {
+		TakePositions(train);
+	}
+	PublishRenderState();
 }
 
-void GameWorld::MoveTrains() {
+void GameWorld::LayerChanges::Clear() {
+	posts.clear();
+	trains.clear();
+	trainsMoved = false;
+}
+
+void GameWorld::PublishRenderState() {
+	// back buffer holds state of some older turn, assignment reuses its memory
+	RenderState& state = renderStates.GetBack();
+	state.posts = map.GetPosts();
+	state.trains = trains;
+	renderStates.Publish();
+}
+
+std::vector<GameWorld::TrainMoveData> GameWorld::MoveTrains() {
 #ifdef _PATHFINDING_DEBUG
 	std::cout << std::endl << std::endl;
 	std::cout << "point black list:";
@@ -136,74 +259,277 @@ void GameWorld::MoveTrains() {
 		std::cout << std::endl << i;
 	}
 	std::cout << std::endl << "edges black list: ";
-	for (auto i : edgesBlackList) {
-		std::cout << std::endl << i.first << ' ' << i.second;
+	for (int i : edgesBlackList) {
+		auto [from, to] = map.GetEdgeSlotVertices(i);
+		std::cout << std::endl << from << ' ' << to;
 	}
 #endif
-	std::sort(trains.begin(), trains.end(), [](const Train& a, const Train& b) {return a.level > b.level; });
-	std::vector<std::thread> helpThreads;
+	std::vector<Train*> trainsToPlan = PrepareTrains();
 	std::vector<TrainMoveData> moveData;
-	int trainsCount = 0;
-	int count = 0;
+#ifdef PARALLEL_PLANNING
+	for (uint64_t i : whitePositions) {
+		planning.takenPositions.Erase(i);
+	}
+	std::vector<bool> speculated(trainsToPlan.size(), false);
+#ifdef SPECULATIVE_PLANNING
+	// proposals planned while waiting for last turn are kept for trains predicted right
+	speculated = CheckSpeculation(trainsToPlan);
+#endif
+	Proposals proposals = ProposeMoves(trainsToPlan, speculated);
+	bool trainsMoved = false;
+#endif
+	for (size_t idx = 0; idx < trainsToPlan.size(); ++idx) {
+		Train& i = *trainsToPlan[idx];
+		for (uint64_t i : whitePositions) {
+			planning.takenPositions.Erase(i);
+		}
+#ifdef PARALLEL_PLANNING
+		// waiting train is planned again once trains before it moved, they may have freed its way
+		const Proposals& planned = speculated[idx] ? speculation.proposals : proposals;
+		bool waits = !planned.moves[idx] || std::get<1>(*planned.moves[idx]) == 0;
+		std::optional<TrainMoveData> trainMove = !(waits && trainsMoved) && MergePlanning(planned.snapshot, planned.states[idx], static_cast<int>(i.idx))
+			? planned.moves[idx]
+			: MoveTrain(planning, i);
+		trainsMoved |= trainMove && std::get<1>(*trainMove) != 0;
+#else
+		std::optional<TrainMoveData> trainMove = MoveTrain(planning, i);
+#endif
+		if (trainMove) {
+			moveData.push_back(*trainMove);
+		}
+#ifdef COOPERATIVE_PATHFINDING
+		else {
+			ReservePosition(planning, GetPosition(i.lineIdx, i.position), 1, planning.reservations.GetWindow());
+		}
+#endif
+	}
+	return moveData;
+}
+
+std::vector<GameWorld::Train*> GameWorld::PrepareTrains() {
+	planning.takenPosts.Clear();
+	for (const auto& [idx, target] : planning.trainsTargets) {
+		if (target != -1) {
+			planning.takenPosts.Insert(target);
+		}
+	}
+#ifdef COOPERATIVE_PATHFINDING
+	ReserveTrains();
+#endif
 	switch (map.GetPopulation(map.TranslateVertexIdx(connection.GetHomeIdx())))
 	{
 	case 0:
 	case 1:
-		marketsToFocus = 1;
+		planning.marketsToFocus = 1;
 		break;
 	case 2:
 	case 3:
 	case 4:
-		marketsToFocus = 2;
+		planning.marketsToFocus = 2;
 		break;
 	case 5:
 	case 6:
-		marketsToFocus = 3;
+		planning.marketsToFocus = 3;
 		break;
 	case 7:
 	default:
-		marketsToFocus = 4;
+		planning.marketsToFocus = 4;
 	}
+	std::vector<Train*> trainsToPlan;
 	for (auto& i : trains) {
 		if (i.cooldown != 0) {
-			if (trainsTargets.count(i.idx)) {
-				trainsTargets.erase(i.idx);
+			if (planning.trainsTargets.count(i.idx)) {
+				planning.trainsTargets.erase(i.idx);
 			}
 			continue;
 		}
-		if (i.owner != connection.GetPlayerIdx()) {
+		if (i.owner != playerOwner) {
 			continue;
 		}
+		trainsToPlan.push_back(&i);
+	}
+	// trains stay in order of server, only planning goes by level
+	std::stable_sort(trainsToPlan.begin(), trainsToPlan.end(), [](const Train* a, const Train* b) {return a->level > b->level; });
+	for (int i : map.GetTowns()) {
+		pointBlackList.Erase(i);
+	}
+	return trainsToPlan;
+}
+
+GameWorld::Proposals GameWorld::ProposeMoves(const std::vector<Train*>& trainsToPlan, const std::vector<bool>& skipped) {
+	// every train is planned against the same snapshot, then plans are merged in level order
+	Proposals proposals{ planning, std::vector<PlanningState>(trainsToPlan.size()), std::vector<std::optional<TrainMoveData>>(trainsToPlan.size()) };
+	std::vector<size_t> toPlan;
+	for (size_t i = 0; i < trainsToPlan.size(); ++i) {
+		if (!skipped[i]) {
+			toPlan.push_back(i);
+		}
+	}
+	planningPool.Run(toPlan.size(), [&](size_t task) {
+		size_t i = toPlan[task];
+		proposals.states[i] = proposals.snapshot;
+		proposals.states[i].marketsToFocus = std::max(0, proposals.snapshot.marketsToFocus - static_cast<int>(i));
+		proposals.moves[i] = MoveTrain(proposals.states[i], *trainsToPlan[i]);
+	});
+	return proposals;
+}
+
+void GameWorld::PlanNextTurn() {
+	// trains and posts are predicted in place for planning, then state of current turn is put back,
+	// so failed turn leaves it untouched
+	std::vector<Train> currentTrains = trains;
+	PostTable currentPosts = map.GetPosts();
+	BitSet currentEdges = edgesBlackList;
+	BitSet currentPoints = pointBlackList;
+	PlanningState currentPlanning = planning;
+	int currentTick = gameTick;
+	try {
+		PredictTrains();
+		++gameTick;
+		std::vector<Train*> trainsToPlan = PrepareTrains();
 		for (uint64_t i : whitePositions) {
-			if (takenPositions.count(i)) {
-				takenPositions.erase(i);
-			}
+			planning.takenPositions.Erase(i);
 		}
-		for (int i : map.GetTowns()) {
-			if (pointBlackList.count(i)) {
-				pointBlackList.erase(i);
-			}
+		speculation.proposals = ProposeMoves(trainsToPlan, std::vector<bool>(trainsToPlan.size(), false));
+		speculation.trains.clear();
+		for (const Train* train : trainsToPlan) {
+			speculation.trains.push_back(*train);
 		}
-		if (auto trainMove = MoveTrain(i)) {
-			++trainsCount;
-			moveData.push_back(*trainMove);
+		speculation.posts = map.GetPosts();
+		speculation.edgesBlackList = edgesBlackList;
+		speculation.pointBlackList = pointBlackList;
+		speculation.gameTick = gameTick;
+	}
+	catch (std::exception& error) {
+		std::cout << "speculative planning failed: " << error.what() << std::endl;
+		speculation.gameTick = -1;
+	}
+	trains = std::move(currentTrains);
+	map.SetPosts(std::move(currentPosts));
+	edgesBlackList = std::move(currentEdges);
+	pointBlackList = std::move(currentPoints);
+	planning = std::move(currentPlanning);
+	gameTick = currentTick;
+}
+
+void GameWorld::PredictTrains() {
+	std::vector<Train> predicted = trains;
+	for (const auto& [lineIdx, speed, trainIdx] : turnMoves) {
+		Train& train = predicted[trainIdxConverter.Translate(trainIdx)];
+		if (static_cast<size_t>(lineIdx) != train.lineIdx) { // train at vertex switches line
+			auto [from, to] = map.GetEdgeVertices(train.lineIdx);
+			int vertex = train.position == 0 ? from : to;
+			train.lineIdx = lineIdx;
+			train.trueLineIdx = lineIdx;
+			train.position = map.GetEdgeVertices(lineIdx).first == vertex ? 0 : map.GetEdgeLength(lineIdx);
+		}
+		train.speed = speed;
+	}
+	for (auto& train : predicted) {
+		if (train.cooldown != 0) {
+			--train.cooldown;
+			continue;
 		}
+		double length = map.GetEdgeLength(train.lineIdx);
+		train.position = std::clamp(train.position + train.speed, 0.0, length);
+		train.truePosition = train.position;
+		if (train.position != 0 && train.position != length) {
+			continue;
+		}
+		train.speed = 0; // stopped at end of line
+		auto [from, to] = map.GetEdgeVertices(train.lineIdx);
+		int vertex = train.position == 0 ? from : to;
+		switch (map.GetPostType(vertex)) {
+		case Post::PostTypes::TOWN:
+			train.load = 0;
+			break;
+		case Post::PostTypes::MARKET:
+		case Post::PostTypes::STORAGE:
+			train.load += map.LoadTrain(vertex, train.capacity - train.load);
+			break;
+		default:
+			break;
+		}
+	}
+	map.PredictPosts();
+	trains = std::move(predicted);
+	edgesBlackList.Clear();
+	pointBlackList.Clear();
+	planning.takenPositions.Clear();
+	for (const auto& train : trains) {
+		BlackListTrain(train);
+		TakePositions(train);
+	}
+}
+
+std::vector<bool> GameWorld::CheckSpeculation(const std::vector<Train*>& trainsToPlan) {
+	std::vector<bool> valid(trainsToPlan.size(), false);
+	bool predicted = speculation.gameTick == gameTick && speculation.trains.size() == trainsToPlan.size()
+		&& speculation.proposals.snapshot.marketsToFocus == planning.marketsToFocus
+		&& speculation.edgesBlackList == edgesBlackList && speculation.pointBlackList == pointBlackList;
+	speculation.gameTick = -1;
+	// planning order decides how many markets every train focuses on
+	for (size_t i = 0; predicted && i < trainsToPlan.size(); ++i) {
+		predicted = speculation.trains[i].idx == trainsToPlan[i]->idx;
 	}
-	while (helpConnections.size() < trainsCount) {
-		helpConnections.emplace_back(connection.GetLogin(), connection.GetPassword(), connection.GetGameName(), false, false);
+	if (!predicted) {
+		return valid;
 	}
-	for (int i = 0; i < trainsCount; ++i) {
-		helpThreads.emplace_back(makeMoveRequest, std::get<0>(moveData[i]), std::get<1>(moveData[i]), std::get<2>(moveData[i]), std::ref(helpConnections[i]));
+	const auto& posts = map.GetPosts();
+	bool postsPredicted = posts.goodsLoad == speculation.posts.goodsLoad && posts.armorLoad == speculation.posts.armorLoad
+		&& posts.populationLoad == speculation.posts.populationLoad;
+	for (size_t i = 0; i < trainsToPlan.size(); ++i) {
+		const Train& train = *trainsToPlan[i];
+		const Train& guess = speculation.trains[i];
+		const auto& move = speculation.proposals.moves[i];
+		valid[i] = train.lineIdx == guess.lineIdx && train.position == guess.position && train.speed == guess.speed
+			&& train.load == guess.load && train.capacity == guess.capacity && train.level == guess.level
+			&& (train.load != 0 || postsPredicted) // empty train chooses target by posts
+			&& move && std::get<1>(*move) != 0; // waiting train may find its way free in real state
 	}
-	for (int i = 0; i < trainsCount; ++i) {
-		helpThreads[i].join();
+	return valid;
+}
+
+bool GameWorld::MergePlanning(const PlanningState& snapshot, const PlanningState& planned, int trainIdx) {
+	auto target = planned.trainsTargets.find(trainIdx);
+	if (target != planned.trainsTargets.end() && target->second != -1 && map.GetPostType(target->second) == Post::PostTypes::STORAGE
+			&& !snapshot.takenPosts.Contains(target->second) && planning.takenPosts.Contains(target->second)) {
+		return false; // storage is taken by train merged before
+	}
+	if (planning.takenPositions.ContainsAdded(snapshot.takenPositions, planned.takenPositions)
+			|| planning.reservations.ConflictsWith(snapshot.reservations, planned.reservations)) {
+		return false;
+	}
+
+	planning.marketsToFocus = planned.marketsToFocus;
+	BitSet released = snapshot.takenPosts;
+	released.Subtract(planned.takenPosts);
+	BitSet taken = planned.takenPosts;
+	taken.Subtract(snapshot.takenPosts);
+	planning.takenPosts.Subtract(released);
+	planning.takenPosts |= taken;
+	planning.takenPositions.ApplyChanges(snapshot.takenPositions, planned.takenPositions);
+	planning.reservations.ApplyChanges(snapshot.reservations, planned.reservations);
+	if (target != planned.trainsTargets.end()) {
+		planning.trainsTargets[trainIdx] = target->second;
+	}
+	else {
+		planning.trainsTargets.erase(trainIdx);
+	}
+	auto plan = planned.cooperativePlans.find(trainIdx);
+	if (plan != planned.cooperativePlans.end()) {
+		planning.cooperativePlans[trainIdx] = plan->second;
 	}
+	else {
+		planning.cooperativePlans.erase(trainIdx);
+	}
+	return true;
 }
 
-std::optional<GameWorld::TrainMoveData> GameWorld::MoveTrain(Train& train) {
+std::optional<GameWorld::TrainMoveData> GameWorld::MoveTrain(PlanningState& state, Train& train) {
 	if (train.load > 0 && train.load != train.capacity) {
-		if (marketsToFocus) {
-			--marketsToFocus;
+		if (state.marketsToFocus) {
+			--state.marketsToFocus;
 		}
 #ifdef _PATHFINDING_DEBUG
 		std::cout << std::endl;
@@ -213,54 +539,54 @@ std::optional<GameWorld::TrainMoveData> GameWorld::MoveTrain(Train& train) {
 	}
 
 	auto [source, onPathTo] = map.GetEdgeVertices(train.lineIdx);
-	double dist = GetDistAndFixSource(train, source, onPathTo);
+	double dist = GetDistAndFixSource(state, train, source, onPathTo);
 
 	int target = map.TranslateVertexIdx(connection.GetHomeIdx());
 	if (train.load == 0) {
 		bool toTargetMarket = false;
-		if (trainsTargets.count(train.idx)) {
-			if (map.GetPostType(trainsTargets[train.idx]) == Post::PostTypes::MARKET) {
+		if (state.trainsTargets.count(train.idx)) {
+			if (map.GetPostType(state.trainsTargets[train.idx]) == Post::PostTypes::MARKET) {
 				toTargetMarket = true;
 			}
-			takenPosts.erase(trainsTargets[train.idx]);
+			state.takenPosts.Erase(state.trainsTargets[train.idx]);
 		}
 
 		if (gameTick < 150) {
-			target = map.GetBestStorage(source, target, train.capacity, takenPosts, edgesBlackList, dist, onPathTo).first;
+			target = map.GetBestStorage(source, target, train.capacity, state.takenPosts, edgesBlackList, dist, onPathTo).first;
 			if (target == -1) {
 				target = map.GetBestStorage(source, target, train.capacity, {}, edgesBlackList, dist, onPathTo).first;
 			}
 		}
-		else if (marketsToFocus || toTargetMarket || train.level == 3) {
+		else if (state.marketsToFocus || toTargetMarket || train.level == 3) {
 			target = map.GetBestMarket(source, target, train.capacity, {}, edgesBlackList, dist, onPathTo).first;
 		}
 		else {
-			target = map.GetBestStorage(source, target, train.capacity, takenPosts, edgesBlackList, dist, onPathTo).first;
+			target = map.GetBestStorage(source, target, train.capacity, state.takenPosts, edgesBlackList, dist, onPathTo).first;
 			if (target == -1) {
 				target = map.GetBestStorage(source, target, train.capacity, {}, edgesBlackList, dist, onPathTo).first;
 			}
 		}
-		takenPosts.insert(target);
-		trainsTargets[train.idx] = target;
+		if (target != -1) {
+			state.takenPosts.Insert(target);
+		}
+		state.trainsTargets[train.idx] = target;
 	}
 	else {
-		if (trainsTargets.count(train.idx)) {
-			if (takenPosts.count(trainsTargets[train.idx])) {
-				takenPosts.erase(trainsTargets[train.idx]);
-			}
-			trainsTargets.erase(train.idx);
+		if (state.trainsTargets.count(train.idx)) {
+			state.takenPosts.Erase(state.trainsTargets[train.idx]);
+			state.trainsTargets.erase(train.idx);
 		}
 	}
 
-	if (marketsToFocus) {
-		--marketsToFocus;
+	if (state.marketsToFocus) {
+		--state.marketsToFocus;
 	}
-	return MoveTrainTo(train, target);
+	return MoveTrainTo(state, train, target);
 }
 
-std::optional<GameWorld::TrainMoveData> GameWorld::MoveTrainTo(Train& train, int to) {
+std::optional<GameWorld::TrainMoveData> GameWorld::MoveTrainTo(PlanningState& state, Train& train, int to) {
 	auto [source, onPathTo] = map.GetEdgeVertices(train.lineIdx);
-	double dist = GetDistAndFixSource(train, source, onPathTo);
+	double dist = GetDistAndFixSource(state, train, source, onPathTo);
 
 #ifdef _PATHFINDING_DEBUG
 	std::cout << std::endl;
@@ -269,7 +595,7 @@ std::optional<GameWorld::TrainMoveData> GameWorld::MoveTrainTo(Train& train, int
 	std::cout << "; target: " << to;
 #endif
 
-	std::unordered_set<int> blackList;
+	BitSet blackList = map.MakeVertexSet();
 	switch (map.GetPostType(to)) {
 	case Post::PostTypes::MARKET:
 		blackList = map.GetStorages();
@@ -277,14 +603,31 @@ std::optional<GameWorld::TrainMoveData> GameWorld::MoveTrainTo(Train& train, int
 	case Post::PostTypes::STORAGE:
 		blackList = map.GetMarkets();
 	}
-	blackList.insert(pointBlackList.begin(), pointBlackList.end());
+	auto wrongPosts = blackList;
+	blackList |= pointBlackList;
 	auto blackPosts = blackList;
-	for (auto [t, i] : trainsTargets) {
-		if (i == to) {
+	for (auto [t, i] : state.trainsTargets) {
+		if (i == to || i == -1) {
 			continue;
 		}
-		blackList.insert(i);
+		blackList.Insert(i);
+	}
+#ifdef COOPERATIVE_PATHFINDING
+	if (to != -1) {
+		if (auto move = FollowCooperativePlan(state, train, to)) {
+			return move;
+		}
+		if (auto move = MoveTrainCooperative(state, train, to, blackList, edgesBlackList)) {
+			return move;
+		}
+		if (auto move = MoveTrainCooperative(state, train, to, blackPosts, {})) {
+			return move;
+		}
+		if (auto move = MoveTrainCooperative(state, train, to, wrongPosts, {})) { // waits for standing trains to leave
+			return move;
+		}
 	}
+#endif
 	int next;
 	if (auto nextOnPath = map.GetNextOnPath(source, to, blackList, edgesBlackList, dist, onPathTo)) {
 		next = nextOnPath.value();
@@ -304,27 +647,30 @@ std::optional<GameWorld::TrainMoveData> GameWorld::MoveTrainTo(Train& train, int
 #endif
 
 	if (train.position == 0 || train.position == map.GetEdgeLength(train.lineIdx)) {
+		if (next == source) {
+			return std::nullopt; // already at target
+		}
 		auto [first, second] = map.GetEdgeVertices(map.GetEdgeIdx(source, next));
 		if (next == first) {
-			return MoveTrainDir(train.idx, map.GetEdgeIdx(first, second), train.lineIdx, train.position, -1);
+			return MoveTrainDir(state, train.idx, map.GetEdgeIdx(first, second), train.lineIdx, train.position, -1);
 		}
 		else {
-			return MoveTrainDir(train.idx, map.GetEdgeIdx(first, second), train.lineIdx, train.position, 1);
+			return MoveTrainDir(state, train.idx, map.GetEdgeIdx(first, second), train.lineIdx, train.position, 1);
 		}
 	}
 	else {
 		auto [first, second] = map.GetEdgeVertices(train.lineIdx);
 		if (next == first) {
-			return MoveTrainDir(train.idx, train.lineIdx, train.position, -1);
+			return MoveTrainDir(state, train.idx, train.lineIdx, train.position, -1);
 		}
 		else if (next == second) {
-			return MoveTrainDir(train.idx, train.lineIdx, train.position, 1);
+			return MoveTrainDir(state, train.idx, train.lineIdx, train.position, 1);
 		}
 		else if (source == first) {
-			return MoveTrainDir(train.idx, train.lineIdx, train.position, -1);
+			return MoveTrainDir(state, train.idx, train.lineIdx, train.position, -1);
 		}
 		else if (source == second) {
-			return MoveTrainDir(train.idx, train.lineIdx, train.position, 1);
+			return MoveTrainDir(state, train.idx, train.lineIdx, train.position, 1);
 		}
 		else {
 			throw std::runtime_error{ "wtf" };
@@ -332,39 +678,268 @@ std::optional<GameWorld::TrainMoveData> GameWorld::MoveTrainTo(Train& train, int
 	}
 }
 
-GameWorld::TrainMoveData GameWorld::MoveTrainDir(int trainIdx, int lineIdx, double position, int dir) {
+std::optional<GameWorld::TrainMoveData> GameWorld::MoveTrainCooperative(PlanningState& state, Train& train, int to, const BitSet& blackList, const BitSet& blackEdges) {
+	struct Node {
+		int lineIdx;
+		int offset;
+		int tick;
+		int parent;
+		int segment; // segment of line crossed to get here, -1 for waiting
+		double estimate; // ticks spent plus remaining distance
+	};
+	const double infinity = std::numeric_limits<double>::infinity();
+	int window = state.reservations.GetWindow();
+	int position = static_cast<int>(train.position);
+	uint64_t start = GetPosition(train.lineIdx, position);
+	state.reservations.ReleasePosition(start, 1);
+
+	auto vertexAt = [&](int lineIdx, int offset) {
+		auto [first, second] = map.GetEdgeVertices(lineIdx);
+		if (offset == 0) {
+			return first;
+		}
+		return offset == map.GetEdgeLength(lineIdx) ? second : -1;
+	};
+	auto [source, onPathTo] = map.GetEdgeVertices(train.lineIdx);
+	GetDistAndFixSource(state, train, source, onPathTo);
+	auto isAvoided = [&](int vertex) { // source is excepted as in black listed path search, so plan keeps passing it
+		return vertex != to && vertex != source && blackList.Contains(vertex);
+	};
+
+	// remaining distance avoids black listed points and lines, so search never waits for standing trains to leave
+	BitSet reversedEdges = map.MakeEdgeSet(); // distances are searched from target
+	for (int slot : blackEdges) {
+		if (map.GetEdgeSlotIdx(slot) == static_cast<int>(train.lineIdx)) {
+			continue; // black listed by train itself
+		}
+		auto [first, second] = map.GetEdgeSlotVertices(slot);
+		map.InsertEdge(reversedEdges, second, first);
+	}
+	std::vector<int> points(map.GetVerticesCount());
+	std::iota(points.begin(), points.end(), 0);
+	auto distances = map.GetDistances(to, points, blackList, reversedEdges);
+	auto remaining = [&](int vertex) {
+		if (vertex == to) {
+			return 0.0;
+		}
+		if (isAvoided(vertex) || !distances[vertex]) {
+			return infinity;
+		}
+		return *distances[vertex];
+	};
+	auto estimate = [&](int lineIdx, int offset) {
+		auto [first, second] = map.GetEdgeVertices(lineIdx);
+		return std::min(offset + remaining(first), map.GetEdgeLength(lineIdx) - offset + remaining(second));
+	};
+
+	std::vector<Node> nodes;
+	std::vector<FlatHashSet> visited(window + 1); // positions by tick
+	auto worse = [&nodes](int a, int b) { // lower estimate first, then deeper node, then older node
+		if (nodes[a].estimate != nodes[b].estimate) {
+			return nodes[a].estimate > nodes[b].estimate;
+		}
+		if (nodes[a].tick != nodes[b].tick) {
+			return nodes[a].tick < nodes[b].tick;
+		}
+		return a > b;
+	};
+	std::priority_queue<int, std::vector<int>, decltype(worse)> queue{ worse };
+	auto push = [&](int lineIdx, int offset, int tick, int parent, int segment) {
+		if (!visited[tick].Insert(GetPosition(lineIdx, offset))) {
+			return;
+		}
+		double value = tick + estimate(lineIdx, offset);
+		if (value == infinity && parent != -1) {
+			return;
+		}
+		nodes.push_back({ lineIdx, offset, tick, parent, segment, value });
+		queue.push(static_cast<int>(nodes.size()) - 1);
+	};
+
+	push(train.lineIdx, position, 0, -1, -1);
+	int goal = -1;
+	while (!queue.empty()) {
+		int current = queue.top();
+		queue.pop();
+		Node node = nodes[current];
+		int vertex = vertexAt(node.lineIdx, node.offset);
+		if (node.tick == window || vertex == to) {
+			goal = current;
+			break;
+		}
+		int tick = node.tick + 1;
+		auto step = [&](int lineIdx, int offset, int segment) {
+			int next = vertexAt(lineIdx, offset);
+			if (segment != -1 && next != -1 && isAvoided(next)) {
+				return;
+			}
+			if (state.reservations.IsPositionReserved(GetPosition(lineIdx, offset), tick)) {
+				return;
+			}
+			if (segment != -1 && state.reservations.IsSegmentReserved(lineIdx, segment, node.tick)) {
+				return;
+			}
+			push(lineIdx, offset, tick, current, segment);
+		};
+		step(node.lineIdx, node.offset, -1);
+		if (vertex == -1) {
+			step(node.lineIdx, node.offset - 1, node.offset - 1);
+			step(node.lineIdx, node.offset + 1, node.offset);
+			continue;
+		}
+		auto [begin, end] = map.GetEdgeSlots(vertex);
+		for (int slot = begin; slot < end; ++slot) {
+			int lineIdx = map.GetEdgeSlotIdx(slot);
+			int length = static_cast<int>(map.GetEdgeLength(lineIdx));
+			if (map.GetEdgeVertices(lineIdx).first == vertex) {
+				step(lineIdx, 1, 0);
+			}
+			else {
+				step(lineIdx, length - 1, length - 1);
+			}
+		}
+	}
+	if (goal == -1 || goal == 0) {
+		ReservePosition(state, start, 1, 1);
+		return std::nullopt;
+	}
+
+	CooperativePlan plan{ to, {} };
+	for (int i = goal; i != -1; i = nodes[i].parent) {
+		plan.steps.push_back({ nodes[i].lineIdx, nodes[i].offset, nodes[i].segment });
+	}
+	std::reverse(plan.steps.begin(), plan.steps.end());
+	return ExecutePlan(state, train, std::move(plan));
+}
+
+std::optional<GameWorld::TrainMoveData> GameWorld::FollowCooperativePlan(PlanningState& state, Train& train, int to) {
+	auto found = state.cooperativePlans.find(static_cast<int>(train.idx));
+	if (found == state.cooperativePlans.end()) {
+		return std::nullopt;
+	}
+	CooperativePlan plan = std::move(found->second);
+	state.cooperativePlans.erase(found);
+	uint64_t start = GetPosition(train.lineIdx, train.position);
+	if (plan.target != to || plan.steps.size() < 3 || GetPosition(plan.steps[1].lineIdx, plan.steps[1].offset) != start) {
+		return std::nullopt;
+	}
+	plan.steps.erase(plan.steps.begin());
+	state.reservations.ReleasePosition(start, 1);
+	for (size_t tick = 1; tick < plan.steps.size(); ++tick) {
+		const PlanStep& step = plan.steps[tick];
+		if (state.reservations.IsPositionReserved(GetPosition(step.lineIdx, step.offset), static_cast<int>(tick))
+			|| (step.segment != -1 && state.reservations.IsSegmentReserved(step.lineIdx, step.segment, static_cast<int>(tick) - 1))) {
+			ReservePosition(state, start, 1, 1);
+			return std::nullopt;
+		}
+	}
+	return ExecutePlan(state, train, std::move(plan));
+}
+
+GameWorld::TrainMoveData GameWorld::ExecutePlan(PlanningState& state, Train& train, CooperativePlan plan) {
+	int window = state.reservations.GetWindow();
+	const auto& steps = plan.steps;
+	for (size_t tick = 1; tick < steps.size(); ++tick) {
+		ReservePosition(state, GetPosition(steps[tick].lineIdx, steps[tick].offset), static_cast<int>(tick), static_cast<int>(tick));
+		if (steps[tick].segment != -1) {
+			state.reservations.ReserveSegment(steps[tick].lineIdx, steps[tick].segment, static_cast<int>(tick) - 1);
+		}
+	}
+	const PlanStep& last = steps.back();
+	ReservePosition(state, GetPosition(last.lineIdx, last.offset), static_cast<int>(steps.size()), window); // unloading at target
+
+#ifdef _PATHFINDING_DEBUG
+	std::cout << "; cooperative, " << steps.size() - 1 << " ticks planned";
+#endif
+	const PlanStep& next = steps[1];
+	if (next.segment == -1) {
+		state.cooperativePlans[static_cast<int>(train.idx)] = std::move(plan);
+		return TrainMoveData{ train.lineIdx, 0, train.idx };
+	}
+	int dir = next.offset == next.segment + 1 ? 1 : -1;
+	bool atPoint = train.position == 0 || train.position == map.GetEdgeLength(train.lineIdx);
+	TrainMoveData move = atPoint
+		? MoveTrainDir(state, train.idx, next.lineIdx, train.lineIdx, train.position, dir)
+		: MoveTrainDir(state, train.idx, train.lineIdx, train.position, dir);
+	if (std::get<1>(move) == 0) {
+		ReservePosition(state, GetPosition(train.lineIdx, train.position), 1, 1); // blocked by a train reserved after planning
+	}
+	else {
+		state.cooperativePlans[static_cast<int>(train.idx)] = std::move(plan);
+	}
+	return move;
+}
+
+void GameWorld::ReserveTrains() {
+	int window = COOPERATIVE_WINDOW;
+	planning.reservations.Reset(window);
+	for (const auto& train : trains) {
+		uint64_t current = GetPosition(train.lineIdx, train.position);
+		if (train.owner == playerOwner) {
+			if (train.cooldown != 0 || (train.load > 0 && train.load != train.capacity)) {
+				ReservePosition(planning, current, 1, window); // won't move this turn
+			}
+			else {
+				ReservePosition(planning, current, 1, 1); // released when the train plans its own move
+			}
+			continue;
+		}
+		// other players' trains are expected to keep their speed until the end of line
+		ReservePosition(planning, current, 1, 1);
+#ifdef NO_BUG_COLLISION
+		if (train.speed == 0) {
+			ReservePosition(planning, GetNextPosition(train.lineIdx, train.position, 1), 1, 1);
+			ReservePosition(planning, GetNextPosition(train.lineIdx, train.position, -1), 1, 1);
+		}
+#endif
+		double length = map.GetEdgeLength(train.lineIdx);
+		double position = train.position;
+		for (int tick = 1; tick <= window; ++tick) {
+			double next = std::clamp(position + train.speed, 0.0, length);
+			if (next != position) {
+				planning.reservations.ReserveSegment(train.lineIdx, static_cast<int>(std::min(position, next)), tick - 1);
+			}
+			position = next;
+			ReservePosition(planning, GetPosition(train.lineIdx, position), tick, tick);
+		}
+	}
+}
+
+void GameWorld::ReservePosition(PlanningState& state, uint64_t position, int fromTick, int toTick) {
+	if (!whitePositions.Contains(position)) {
+		state.reservations.ReservePosition(position, fromTick, toTick);
+	}
+}
+
+GameWorld::TrainMoveData GameWorld::MoveTrainDir(PlanningState& state, int trainIdx, int lineIdx, double position, int dir) {
 	uint64_t nextPosition = GetNextPosition(lineIdx, position, dir);
-	if (takenPositions.count(nextPosition)) {
+	if (state.takenPositions.Contains(nextPosition)) {
 #ifdef _PATHFINDING_DEBUG
 		std::cout << "; CAN'T MOVE ";
 #endif
 		return TrainMoveData{ lineIdx, 0, trainIdx };
 	}
 	uint64_t currentPosition = GetPosition(lineIdx, position);
-	if (takenPositions.count(currentPosition)) {
-		takenPositions.erase(currentPosition);
-	}
-	takenPositions.insert(nextPosition);
+	state.takenPositions.Erase(currentPosition);
+	state.takenPositions.Insert(nextPosition);
 	return TrainMoveData{ lineIdx, dir, trainIdx };
 }
 
-GameWorld::TrainMoveData GameWorld::MoveTrainDir(int trainIdx, int lineIdx, int prevLineIdx, double position, int dir) {
+GameWorld::TrainMoveData GameWorld::MoveTrainDir(PlanningState& state, int trainIdx, int lineIdx, int prevLineIdx, double position, int dir) {
 	uint64_t nextPosition = GetNextPosition(prevLineIdx, lineIdx, position, dir);
-	if (takenPositions.count(nextPosition)) {
+	if (state.takenPositions.Contains(nextPosition)) {
 #ifdef _PATHFINDING_DEBUG
 		std::cout << "; CAN'T MOVE ";
 #endif
 		return TrainMoveData{ lineIdx, 0, trainIdx };
 	}
 	uint64_t currentPosition = GetPosition(prevLineIdx, position);
-	if (takenPositions.count(currentPosition)) {
-		takenPositions.erase(currentPosition);
-	}
-	takenPositions.insert(nextPosition);
+	state.takenPositions.Erase(currentPosition);
+	state.takenPositions.Insert(nextPosition);
 	return TrainMoveData{ lineIdx, dir, trainIdx };
 }
 
-double GameWorld::GetDistAndFixSource(const Train& train, int& source, int& onPathTo) {
+double GameWorld::GetDistAndFixSource(const PlanningState& state, const Train& train, int& source, int& onPathTo) {
 	auto [first, second] = map.GetEdgeVertices(train.lineIdx);
 	double dist = train.position;
 	if (train.position >= map.GetEdgeLength(train.lineIdx) / 2) {
@@ -373,7 +948,7 @@ double GameWorld::GetDistAndFixSource(const Train& train, int& source, int& onPa
 	}
 	if (first == source) {
 		for (int i = 0; i < train.position; ++i) {
-			if (takenPositions.count(GetPosition(train.lineIdx, i))) {
+			if (state.takenPositions.Contains(GetPosition(train.lineIdx, i))) {
 				std::swap(source, onPathTo);
 				dist = map.GetEdgeLength(train.lineIdx) - train.position;
 			}
@@ -381,7 +956,7 @@ double GameWorld::GetDistAndFixSource(const Train& train, int& source, int& onPa
 	}
 	else {
 		for (int i = map.GetEdgeLength(train.lineIdx) - 0.5; i > train.position; --i) {
-			if (takenPositions.count(GetPosition(train.lineIdx, i))) {
+			if (state.takenPositions.Contains(GetPosition(train.lineIdx, i))) {
 				std::swap(source, onPathTo);
 				dist = train.position;
 			}
@@ -390,79 +965,138 @@ double GameWorld::GetDistAndFixSource(const Train& train, int& source, int& onPa
 	return dist;
 }
 
-void GameWorld::UpdateTrains(const std::string& jsonData) {
-	std::stringstream ss;
-	ss << jsonData;
-	Json::Document doc = Json::Load(ss);
-	auto nodeMap = doc.GetRoot().AsMap();
-	trainIdxConverter.clear();
-	trains.clear();
-	edgesBlackList.clear();
-	pointBlackList.clear();
-	takenPositions.clear();
-	trains.reserve(nodeMap["trains"].AsArray().size());
-	for (const auto& node : nodeMap["trains"].AsArray()) {
-		auto trainMap = node.AsMap();
-		trainIdxConverter[trainMap["idx"].AsInt()] = trains.size();
-		trains.emplace_back( static_cast<size_t>(trainMap["idx"].AsInt()), static_cast<size_t>(trainMap["line_idx"].AsInt()), 
-			trainMap["position"].AsDouble(), trainMap["speed"].AsDouble());
-		Train& train = *trains.rbegin();
-		train.capacity = trainMap["goods_capacity"].AsDouble();
-		train.load = trainMap["goods"].AsDouble();
-		train.owner = trainMap["player_idx"].AsString();
-		train.cooldown = trainMap["cooldown"].AsInt();
-		train.level = trainMap["level"].AsInt();
-
-
-		if (train.owner == connection.GetPlayerIdx()) {
-			if (train.level < 3) {
-				train.nextLevelPrice = trainMap["next_level_price"].AsInt();
-			}
-			takenPositions.insert(GetPosition(train.lineIdx, train.position));
+int GameWorld::InternOwner(std::string_view owner) {
+	for (size_t i = 0; i < owners.size(); ++i) { // few players, lookup allocates nothing
+		if (owners[i] == owner) {
+			return static_cast<int>(i);
 		}
-		else {
-			takenPositions.insert(GetPosition(train.lineIdx, train.position));
-#ifdef NO_BUG_COLLISION
-			if (train.speed != 0) {
-				takenPositions.insert(GetNextPosition(train.lineIdx, train.position, train.speed));
+	}
+	owners.emplace_back(owner);
+	return static_cast<int>(owners.size() - 1);
+}
+
+void GameWorld::UpdateTrains(Json::Reader& trainsArray) {
+	std::vector<bool>& updated = trainsUpdated;
+	updated.assign(trains.size(), false);
+	trainsArray.ReadArray([&]() {
+		Train decoded{ 0, 0, 0.0, 0.0 };
+		trainsArray.ReadDict([&](std::string_view key) {
+			if (key == "idx") {
+				decoded.idx = static_cast<size_t>(trainsArray.ReadInt());
+			}
+			else if (key == "line_idx") {
+				decoded.lineIdx = static_cast<size_t>(trainsArray.ReadInt());
+			}
+			else if (key == "position") {
+				decoded.position = trainsArray.ReadDouble();
+			}
+			else if (key == "speed") {
+				decoded.speed = trainsArray.ReadDouble();
+			}
+			else if (key == "goods_capacity") {
+				decoded.capacity = trainsArray.ReadDouble();
+			}
+			else if (key == "goods") {
+				decoded.load = trainsArray.ReadDouble();
+			}
+			else if (key == "player_idx") {
+				decoded.owner = InternOwner(trainsArray.ReadString());
+			}
+			else if (key == "cooldown") {
+				decoded.cooldown = trainsArray.ReadInt();
+			}
+			else if (key == "level") {
+				decoded.level = trainsArray.ReadInt();
+			}
+			else if (key == "next_level_price") {
+				decoded.nextLevelPrice = trainsArray.ReadInt();
 			}
 			else {
-				takenPositions.insert(GetNextPosition(train.lineIdx, train.position, 1));
-				takenPositions.insert(GetNextPosition(train.lineIdx, train.position, -1));
+				trainsArray.Skip();
 			}
-#else
-			takenPositions.insert(GetNextPosition(train.lineIdx, train.position, train.speed));
-#endif
+		});
+		decoded.trueLineIdx = decoded.lineIdx;
+		decoded.truePosition = decoded.position;
+		int idx = trainIdxConverter.Find(decoded.idx);
+		if (idx == -1) {
+			trainIdxConverter.Add(decoded.idx, static_cast<int>(trains.size()));
+			changes.trains.push_back(decoded.idx);
+			changes.trainsMoved = true;
+			trains.push_back(decoded);
+			updated.push_back(true);
+			return;
+		}
+		updated[idx] = true;
+		Train& train = trains[idx];
+		bool moved = train.lineIdx != decoded.lineIdx || train.position != decoded.position || train.speed != decoded.speed;
+		if (!moved && train.load == decoded.load && train.capacity == decoded.capacity && train.cooldown == decoded.cooldown
+				&& train.level == decoded.level && train.nextLevelPrice == decoded.nextLevelPrice && train.owner == decoded.owner) {
+			return;
 		}
+		changes.trains.push_back(decoded.idx);
+		changes.trainsMoved |= moved;
+		train = decoded;
+	});
+	if (std::find(updated.begin(), updated.end(), false) != updated.end()) { // some trains are gone
+		size_t kept = 0;
+		trainIdxConverter.Clear();
+		for (size_t i = 0; i < trains.size(); ++i) {
+			if (updated[i]) {
+				trainIdxConverter.Add(trains[i].idx, static_cast<int>(kept));
+				trains[kept++] = trains[i];
+			}
+		}
+		trains.erase(trains.begin() + kept, trains.end());
+		changes.trainsMoved = true;
+	}
+}
 
-		if (train.speed == -1.0) {
-			edgesBlackList.insert(map.GetEdgeVertices(train.lineIdx));
+void GameWorld::BlackListTrain(const Train& train) {
+	if (train.speed == -1.0) {
+		auto [from, to] = map.GetEdgeVertices(train.lineIdx);
+		map.InsertEdge(edgesBlackList, from, to);
+	}
+	else if (train.speed == 1.0) {
+		auto [from, to] = map.GetEdgeVertices(train.lineIdx);
+		map.InsertEdge(edgesBlackList, to, from);
+	}
+	else {
+		if (train.position == 0) {
+			pointBlackList.Insert(map.GetEdgeVertices(train.lineIdx).first);
 		}
-		else if (train.speed == 1.0) {
-			std::pair<int, int> edge = map.GetEdgeVertices(train.lineIdx);
-			std::swap(edge.first, edge.second);
-			edgesBlackList.insert(edge);
+		else if (train.position == map.GetEdgeLength(train.lineIdx)) {
+			pointBlackList.Insert(map.GetEdgeVertices(train.lineIdx).second);
 		}
 		else {
-			if (train.position == 0) {
-				pointBlackList.insert(map.GetEdgeVertices(train.lineIdx).first);
-			}
-			else if (train.position == map.GetEdgeLength(train.lineIdx)) {
-				pointBlackList.insert(map.GetEdgeVertices(train.lineIdx).second);
-			}
-			else {
-				std::pair<int, int> edge = map.GetEdgeVertices(train.lineIdx);
-				edgesBlackList.insert(edge);
-				std::swap(edge.first, edge.second);
-				edgesBlackList.insert(edge);
-			}
+			auto [from, to] = map.GetEdgeVertices(train.lineIdx);
+			map.InsertEdge(edgesBlackList, from, to);
+			map.InsertEdge(edgesBlackList, to, from);
 		}
 	}
 }
 
-void GameWorld::DrawTrains(SdlWindow& window) {
-	int k = 0;
-	for (const auto& i : trains) {
+void GameWorld::TakePositions(const Train& train) {
+	if (train.owner == playerOwner) {
+		planning.takenPositions.Insert(GetPosition(train.lineIdx, train.position));
+	}
+	else {
+		planning.takenPositions.Insert(GetPosition(train.lineIdx, train.position));
+#ifdef NO_BUG_COLLISION
+		if (train.speed != 0) {
+			planning.takenPositions.Insert(GetNextPosition(train.lineIdx, train.position, train.speed));
+		}
+		else {
+			planning.takenPositions.Insert(GetNextPosition(train.lineIdx, train.position, 1));
+			planning.takenPositions.Insert(GetNextPosition(train.lineIdx, train.position, -1));
+		}
+#else
+		planning.takenPositions.Insert(GetNextPosition(train.lineIdx, train.position, train.speed));
+#endif
+	}
+}
+
+void GameWorld::DrawTrains(SdlWindow& window, const std::vector<Train>& snapshot) {
+	for (const auto& i : snapshot) {
 		double from, to;
 		std::pair<int, int> vertices = map.GetEdgeVertices(i.lineIdx);
 		std::pair<double, double> a = map.GetPointCoord(vertices.first);
@@ -504,6 +1138,30 @@ void GameWorld::DrawTrains(SdlWindow& window) {
 	}
 }
 
+void GameWorld::BenchmarkHashes() {
+	std::vector<std::pair<int, int>> edges;
+	std::vector<uint64_t> positions; // line ends repeat for every line of the point
+	for (int lineIdx : map.GetEdgeIdxs()) {
+		auto [first, second] = map.GetEdgeVertices(lineIdx);
+		edges.emplace_back(first, second);
+		edges.emplace_back(second, first);
+		for (int i = 0; i <= map.GetEdgeLength(lineIdx); ++i) {
+			positions.push_back(GetPosition(lineIdx, i));
+		}
+	}
+	RunHashBenchmark(edges, positions, std::cout);
+}
+
+void GameWorld::BenchmarkScores() {
+	double capacity = 0;
+	for (const auto& train : trains) {
+		if (train.owner == playerOwner) {
+			capacity = std::max(capacity, train.capacity);
+		}
+	}
+	map.BenchmarkScores(map.TranslateVertexIdx(connection.GetHomeIdx()), capacity, std::cout);
+}
+
 uint64_t GameWorld::GetPosition(int vertex) {
 	uint64_t result = 0;
 	result |= vertex;
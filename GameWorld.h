@@ -1,12 +1,29 @@
 #pragma once
 #include "Map.h"
 #include "ServerConnection.h"
+#include "ConnectionPool.h"
+#include "json.h"
+#include "FlatHash.h"
+#include "ReservationTable.h"
+#include "ThreadPool.h"
+#include "TripleBuffer.h"
+#include <unordered_map>
 
 class GameWorld {
 private:
 
 	using TrainMoveData = std::tuple<int, int, int>;
 
+	struct PlanStep { // position of train at tick of cooperative plan
+		int lineIdx;
+		int offset;
+		int segment; // segment of line crossed to get here, -1 for waiting
+	};
+	struct CooperativePlan {
+		int target;
+		std::vector<PlanStep> steps; // one per tick, starting at current position
+	};
+
 	class Train {
 	public:
 		size_t idx;
@@ -20,41 +37,99 @@ private:
 		double capacity;
 		double load;
 		int cooldown;
-		std::string owner;
+		int owner = -1; // position in owners
 		Train(size_t idx, size_t lineIdx, double position, double speed) : idx{ idx }, lineIdx{ lineIdx }, trueLineIdx{ lineIdx }, position{ position }, truePosition{ position }, speed{ speed } {}
 	};
 
-	std::vector<ServerConnection> helpConnections;
-	int marketsToFocus;
+	struct PlanningState { // changed by planning of every train, trains planned in parallel get own copies
+		int marketsToFocus = 0;
+		BitSet takenPosts;
+		FlatHashSet takenPositions;
+		ReservationTable reservations; // positions of all trains for next ticks, filled by cooperative planning
+		std::unordered_map<int, int> trainsTargets;
+		std::unordered_map<int, CooperativePlan> cooperativePlans; // by train idx, followed while free of reservations
+	};
+	struct LayerChanges { // made to posts and trains by last layer 1, derived state is rebuilt only for what changed
+		std::vector<int> posts; // vertices of changed posts
+		std::vector<size_t> trains; // idx of added or changed trains
+		bool trainsMoved = false; // line, position or speed of some train changed, or trains were added or removed
+		void Clear(); // keeps capacity, so decoding of later turns doesn't allocate
+	};
+	struct RenderState { // copy of dynamic state drawn by render loop, published once per turn
+		PostTable posts;
+		std::vector<Train> trains;
+	};
+	struct Proposals { // moves of trains planned against one snapshot, merged in level order
+		PlanningState snapshot;
+		std::vector<PlanningState> states; // by position of train in planning order
+		std::vector<std::optional<TrainMoveData>> moves;
+	};
+	struct Speculation { // next turn planned against predicted state while the server answers this one
+		int gameTick = -1; // turn it was planned for, -1 once used
+		std::vector<Train> trains; // predicted trains to plan in planning order
+		PostTable posts;
+		BitSet edgesBlackList;
+		BitSet pointBlackList;
+		Proposals proposals;
+	};
+
 	double spentArmor = 0;
 	ServerConnection connection;
+	ConnectionPool movePool; // helper connections sending MOVE requests of one turn in parallel
 	TextureManager& textureManager;
 	Map map;
 	std::vector<Train> trains;
-	std::map<size_t, size_t> trainIdxConverter;
-	std::unordered_set<std::pair<int, int>> edgesBlackList;
-	std::unordered_set<int> pointBlackList;
-	std::unordered_set<int> takenPosts;
-	std::unordered_set<uint64_t> takenPositions;
-	std::unordered_set<uint64_t> whitePositions;
-	std::unordered_map<int, int> trainsTargets;
+	std::vector<std::string> owners; // player idx of every owner of trains seen so far
+	int playerOwner = -1; // our position in owners
+	IdRemap trainIdxConverter; // server train idx -> idx in trains, trains are kept in order of server
+	BitSet edgesBlackList; // directed edges taken by trains, see Graph::InsertEdge
+	BitSet pointBlackList;
+	FlatHashSet whitePositions;
+	LayerChanges changes;
+	std::vector<bool> trainsUpdated; // scratch of UpdateTrains, kept between turns
+	TripleBuffer<RenderState> renderStates; // written by Update, read by Draw on another thread
+	PlanningState planning;
+	ThreadPool planningPool;
+	Speculation speculation;
+	std::future<std::vector<ServerConnection::Response>> turnResponses; // to requests sent by last MakeMove, collected by Update
+	std::vector<TrainMoveData> turnMoves; // sent by last MakeMove, applied to predicted trains
+	double spentBeforeTurn = 0;
+	bool upgradeSent = false;
 	int gameTick = 0;
 public:
 	GameWorld(const std::string& playerName, const std::string& gameName, int playerCount, int numTurns, TextureManager& textureManager);
 	double GetScore();
 	void Update(); // updates map and trains
-	void Draw(SdlWindow& window);
+	void Draw(SdlWindow& window); // draws last published state, never waits for update
 	void MakeMove();
 private:
 	void Update(const std::string& jsonData);
-	void MoveTrains();
-	std::optional<TrainMoveData> MoveTrain(Train& train);
-	std::optional<TrainMoveData> MoveTrainTo(Train& train, int to);
-	TrainMoveData MoveTrainDir(int trainIdx, int lineIdx, double position, int dir);
-	TrainMoveData MoveTrainDir(int trainIdx, int lineIdx, int prevLineIdx, double position, int dir);
-	double GetDistAndFixSource(const Train& train, int& source, int& onPathTo);
-	void UpdateTrains(const std::string& jsonData);
-	void DrawTrains(SdlWindow& window);
+	std::string FinishTurn(); // waits for answers to last MakeMove, returns layer 1, throws like blocking requests would
+	std::vector<TrainMoveData> MoveTrains(); // plans moves of our trains
+	std::vector<Train*> PrepareTrains(); // resets planning state for new turn, returns our trains to plan in level order
+	Proposals ProposeMoves(const std::vector<Train*>& trainsToPlan, const std::vector<bool>& skipped); // plans every not skipped train in parallel against current planning state
+	void PlanNextTurn(); // fills speculation, state of current turn is kept
+	void PredictTrains(); // applies moves of this turn, then advances trains and posts by one tick the way the server is expected to
+	std::vector<bool> CheckSpeculation(const std::vector<Train*>& trainsToPlan); // trains whose speculative proposals stay valid for real state
+	bool MergePlanning(const PlanningState& snapshot, const PlanningState& planned, int trainIdx); // applies changes made by planning of train against snapshot, false on conflict with trains merged before
+	std::optional<TrainMoveData> MoveTrain(PlanningState& state, Train& train);
+	std::optional<TrainMoveData> MoveTrainTo(PlanningState& state, Train& train, int to);
+	std::optional<TrainMoveData> MoveTrainCooperative(PlanningState& state, Train& train, int to, const BitSet& blackList, const BitSet& blackEdges); // windowed space-time search around reservations, nullopt if no plan
+	std::optional<TrainMoveData> FollowCooperativePlan(PlanningState& state, Train& train, int to); // continues last turn's plan while it is free of reservations
+	TrainMoveData ExecutePlan(PlanningState& state, Train& train, CooperativePlan plan); // reserves plan and makes its first step
+	void ReserveTrains(); // reserves standing and predicted positions of all trains before planning
+	void ReservePosition(PlanningState& state, uint64_t position, int fromTick, int toTick); // skips towns, trains never collide there
+	TrainMoveData MoveTrainDir(PlanningState& state, int trainIdx, int lineIdx, double position, int dir);
+	TrainMoveData MoveTrainDir(PlanningState& state, int trainIdx, int lineIdx, int prevLineIdx, double position, int dir);
+	double GetDistAndFixSource(const PlanningState& state, const Train& train, int& source, int& onPathTo);
+	int InternOwner(std::string_view owner);
+	void UpdateTrains(Json::Reader& trainsArray); // updates trains in place from "trains" array of layer 1, fills changes
+	void BlackListTrain(const Train& train); // adds edges and points taken by train to black lists
+	void TakePositions(const Train& train); // adds positions train may take next tick
+	void PublishRenderState();
+	void DrawTrains(SdlWindow& window, const std::vector<Train>& snapshot);
+	void BenchmarkHashes(); // prints hash quality and lookup speed for edges and positions of current map
+	void BenchmarkScores(); // prints speed of choosing market for the biggest player's train from every vertex
 	uint64_t GetPosition(int vertex);
 	uint64_t GetPosition(int lineIdx, double position);
 	uint64_t GetNextPosition(int lineIdx, double position, int speed);
@@ -0,0 +1,62 @@
+#include "IdRemap.h"
+#include <stdexcept>
+
+constexpr size_t MAX_DENSE_ID = 1 << 22;
+
+void IdRemap::Clear() {
+	table.clear();
+	sparse.clear();
+	count = 0;
+}
+
+void IdRemap::Add(size_t id, int localIdx) {
+	if (id >= MAX_DENSE_ID) {
+		count += sparse.count(id) == 0;
+		sparse[id] = localIdx;
+		return;
+	}
+	if (id >= table.size()) {
+		table.resize(id + 1, -1);
+	}
+	count += table[id] == -1;
+	table[id] = localIdx;
+}
+
+int IdRemap::Translate(size_t id) const {
+	int result = Find(id);
+	if (result == -1) {
+		throw std::out_of_range{ "unknown id" };
+	}
+	return result;
+}
+
+int IdRemap::Find(size_t id) const {
+	if (id < table.size()) {
+		return table[id];
+	}
+	if (sparse.empty()) {
+		return -1;
+	}
+	auto it = sparse.find(id);
+	return it == sparse.end() ? -1 : it->second;
+}
+
+void IdRemap::Translate(const int* ids, int* result, size_t count) const {
+	for (size_t i = 0; i < count; ++i) {
+		size_t id = static_cast<size_t>(ids[i]);
+		result[i] = id < table.size() ? table[id] : Find(id);
+		if (result[i] == -1) {
+			throw std::out_of_range{ "unknown id" };
+		}
+	}
+}
+
+std::vector<int> IdRemap::Translate(const std::vector<int>& ids) const {
+	std::vector<int> result(ids.size());
+	Translate(ids.data(), result.data(), ids.size());
+	return result;
+}
+
+size_t IdRemap::Size() const {
+	return count;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+
+class IdRemap { // translates server ids into local indices, dense table for compact ids
+public:
+	void Clear();
+	void Add(size_t id, int localIdx);
+	int Translate(size_t id) const; // throws std::out_of_range for unknown id
+	int Find(size_t id) const; // -1 for unknown id
+	void Translate(const int* ids, int* result, size_t count) const; // bulk translation, throws for unknown ids
+	std::vector<int> Translate(const std::vector<int>& ids) const;
+	size_t Size() const;
+private:
+	std::vector<int> table; // -1 for unknown ids
+	std::unordered_map<size_t, int> sparse; // ids too large for the dense table
+	size_t count = 0;
+};
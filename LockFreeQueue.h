@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+// Bounded multi-producer multi-consumer queue. Every cell carries a sequence number telling whether it is
+// free for the producer or filled for the consumer of the current lap, so push and pop only race on one counter each.
+template <typename T>
+class LockFreeQueue {
+public:
+	explicit LockFreeQueue(size_t capacity); // rounded up to power of two
+	LockFreeQueue(const LockFreeQueue&) = delete;
+	LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+	bool TryPush(const T& value); // false if full
+	bool TryPop(T& value); // false if empty
+private:
+	struct Cell {
+		std::atomic<size_t> sequence;
+		T value;
+	};
+	std::unique_ptr<Cell[]> cells;
+	size_t mask;
+	alignas(64) std::atomic<size_t> pushPosition{ 0 };
+	alignas(64) std::atomic<size_t> popPosition{ 0 };
+};
+
+template <typename T>
+LockFreeQueue<T>::LockFreeQueue(size_t capacity) {
+	size_t size = 2;
+	while (size < capacity) {
+		size *= 2;
+	}
+	cells.reset(new Cell[size]);
+	mask = size - 1;
+	for (size_t i = 0; i < size; ++i) {
+		cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+template <typename T>
+bool LockFreeQueue<T>::TryPush(const T& value) {
+	size_t position = pushPosition.load(std::memory_order_relaxed);
+	while (true) {
+		Cell& cell = cells[position & mask];
+		size_t sequence = cell.sequence.load(std::memory_order_acquire);
+		auto lag = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+		if (lag == 0) {
+			if (pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				cell.value = value;
+				cell.sequence.store(position + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (lag < 0) {
+			return false; // cell still holds value of previous lap
+		}
+		else {
+			position = pushPosition.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+template <typename T>
+bool LockFreeQueue<T>::TryPop(T& value) {
+	size_t position = popPosition.load(std::memory_order_relaxed);
+	while (true) {
+		Cell& cell = cells[position & mask];
+		size_t sequence = cell.sequence.load(std::memory_order_acquire);
+		auto lag = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1);
+		if (lag == 0) {
+			if (popPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				value = cell.value;
+				cell.sequence.store(position + mask + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (lag < 0) {
+			return false; // cell is not filled yet
+		}
+		else {
+			position = popPosition.load(std::memory_order_relaxed);
+		}
+	}
+}
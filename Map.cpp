@@ -1,149 +1,205 @@
 #include "Map.h"
 #include "json.h"
-#include <sstream>
+#include <cmath>
+#include <limits>
+#include <chrono>
 
 constexpr int TEXTURE_SIDE = 40;
+constexpr size_t SCORE_ROUNDS = 1 << 10; // passes over every origin vertex in BenchmarkScores
 
-Map::Map(const std::string& jsonStructureData, const std::string& jsonCoordinatesData, const std::string& jsonDynamicData, TextureManager& textureManager) : 
+Map::Map(const std::string& jsonStructureData, const std::string& jsonCoordinatesData, const std::string& jsonDynamicData, TextureManager& textureManager, bool precomputeDistances) : 
 		Graph{ jsonStructureData, jsonCoordinatesData },
-		textureManager{ textureManager } {
-	posts.resize(adjacencyList.size(), { Post::PostTypes::NONE, 0, "", 0 });
+		textureManager{ textureManager },
+		markets{ MakeVertexSet() },
+		storages{ MakeVertexSet() },
+		towns{ MakeVertexSet() } {
+	if (precomputeDistances) {
+		PrecomputeDistances();
+	}
+	for (int i = 0; i < adjacencyList.size(); ++i) {
+		if (adjacencyList[i].postIdx) {
+			postIdxConverter.Add(*adjacencyList[i].postIdx, i);
+		}
+	}
+	posts.Resize(adjacencyList.size());
 	Update(jsonDynamicData);
 	for (int i = 0; i < adjacencyList.size(); ++i) {
-		if (posts[i].type == Post::PostTypes::MARKET) {
-			markets.insert(i);
+		if (posts.type[i] == Post::PostTypes::MARKET) {
+			markets.Insert(i);
 		}
-		else if (posts[i].type == Post::PostTypes::STORAGE) {
-			storages.insert(i);
+		else if (posts.type[i] == Post::PostTypes::STORAGE) {
+			storages.Insert(i);
 		}
-		else if (posts[i].type == Post::PostTypes::TOWN) {
-			towns.insert(i);
+		else if (posts.type[i] == Post::PostTypes::TOWN) {
+			towns.Insert(i);
 		}
 	}
 }
 
-std::pair<int, double> Map::GetBestMarket(int from, int home, double maxLoad, const std::unordered_set<int>& vBlackList, const std::unordered_set<edge> eBlackList, int dist, int onPathTo) {
-	double maxTime = posts[home].goodsLoad / posts[home].populationLoad;
-	int bestIdx = -1;
-	double bestK = 0;
-	for (int i = 0; i < posts.size(); ++i) {
-		if (posts[i].type != Post::PostTypes::MARKET) {
+// Gives the same result as scanning candidates in index order and taking the first one with maximal K.
+// K of the seed, the first candidate with the best upper bound, is computed first, candidates whose upper bound can't reach it
+// are skipped, the rest are scored together by one batched search.
+template<typename BatchK>
+static std::pair<int, double> SelectBest(const std::vector<int>& candidates, const std::vector<double>& bounds, size_t seed, BatchK batchK) {
+	if (candidates.empty()) {
+		return { -1, 0 };
+	}
+	double seedK = batchK(std::vector<int>{ candidates[seed] })[0];
+	bool prune = std::isfinite(seedK);
+	std::vector<int> rest;
+	std::vector<char> pruned(candidates.size(), false);
+	for (size_t i = 0; i < candidates.size(); ++i) {
+		if (i == seed) {
 			continue;
 		}
-		if (vBlackList.count(i) != 0) {
+		if (prune && bounds[i] + 1e-9 * (1 + std::abs(bounds[i])) < seedK) { // margin covers rounding in K
+			pruned[i] = true;
 			continue;
 		}
-		double k = GetMarketK(from, i, home, maxLoad, vBlackList, eBlackList, dist, onPathTo);
-		if (k > bestK || bestIdx == -1) {
-			bestIdx = i;
-			bestK = k;
-		}
+		rest.push_back(candidates[i]);
 	}
-	return { bestIdx, bestK };
-}
-
-std::pair<int, double> Map::GetBestStorage(int from, int home, double maxLoad, const std::unordered_set<int>& vBlackList, const std::unordered_set<edge> eBlackList, int dist, int onPathTo) {
+	std::vector<double> restK = rest.empty() ? std::vector<double>{} : batchK(rest);
 	int bestIdx = -1;
 	double bestK = 0;
-	for (int i = 0; i < posts.size(); ++i) {
-		if (posts[i].type != Post::PostTypes::STORAGE) {
-			continue;
-		}
-		if (vBlackList.count(i) != 0) {
+	for (size_t i = 0, j = 0; i < candidates.size(); ++i) {
+		if (pruned[i]) {
 			continue;
 		}
-		double k = GetStorageK(from, i, home, maxLoad, vBlackList, eBlackList, dist, onPathTo);
+		double k = i == seed ? seedK : restK[j++];
 		if (k > bestK || bestIdx == -1) {
-			bestIdx = i;
+			bestIdx = candidates[i];
 			bestK = k;
 		}
 	}
 	return { bestIdx, bestK };
 }
 
+std::pair<int, double> Map::GetBestMarket(int from, int home, double maxLoad, const BitSet& vBlackList, const BitSet& eBlackList, int dist, int onPathTo) {
+	ScoreFields fields{ posts.goodsLoad.data(), posts.goodsCapacity.data(), posts.refillRate.data() };
+	return GetBestPost(markets, storages, fields, posts.populationLoad[home], from, home, maxLoad, vBlackList, eBlackList, dist, onPathTo);
+}
+
+std::pair<int, double> Map::GetBestStorage(int from, int home, double maxLoad, const BitSet& vBlackList, const BitSet& eBlackList, int dist, int onPathTo) {
+	ScoreFields fields{ posts.armorLoad.data(), posts.armorCapacity.data(), posts.refillRate.data() };
+	return GetBestPost(storages, markets, fields, 0.0, from, home, maxLoad, vBlackList, eBlackList, dist, onPathTo);
+}
+
+std::pair<int, double> Map::GetBestPost(const BitSet& kind, const BitSet& otherKind, const ScoreFields& fields, double consumption,
+		int from, int home, double maxLoad, const BitSet& vBlackList, const BitSet& eBlackList, int dist, int onPathTo) {
+	std::vector<int> candidates;
+	std::vector<double> distancesTo;
+	std::vector<double> distancesFrom;
+	for (int i : kind) {
+		if (vBlackList.Contains(i)) {
+			continue;
+		}
+		candidates.push_back(i);
+		distancesTo.push_back(GetDistanceLowerBound(from, i, eBlackList, dist, onPathTo));
+		distancesFrom.push_back(GetDistance(i, home));
+	}
+	std::vector<double> bounds(candidates.size(), std::numeric_limits<double>::infinity());
+	size_t seed = 0;
+	if (maxLoad >= 0 && !candidates.empty()) {
+		seed = ScoreCandidates(fields, maxLoad, consumption, candidates.data(), distancesTo.data(), distancesFrom.data(), candidates.size(), bounds.data());
+	}
+	BitSet forbidden = otherKind;
+	forbidden |= vBlackList;
+	return SelectBest(candidates, bounds, seed, [&](const std::vector<int>& targets) {
+		std::vector<std::optional<double>> distances = GetDistances(from, targets, forbidden, eBlackList, dist, onPathTo);
+		std::vector<double> to(targets.size());
+		std::vector<double> back(targets.size());
+		for (size_t i = 0; i < targets.size(); ++i) {
+			to[i] = distances[i] ? *distances[i] : std::numeric_limits<double>::infinity(); // unreachable post is the worst choice
+			back[i] = GetDistance(targets[i], home);
+		}
+		std::vector<double> result(targets.size());
+		ScoreCandidates(fields, maxLoad, consumption, targets.data(), to.data(), back.data(), targets.size(), result.data());
+		return result;
+	});
+}
+
 int Map::GetArmor(int idx) {
-	return posts[idx].armorLoad;
+	return posts.armorLoad[idx];
 }
 
 int Map::GetProduct(int idx) {
-	return posts[idx].goodsLoad;
+	return posts.goodsLoad[idx];
 }
 
 int Map::GetLevel(int idx)
 {
-	return posts[idx].level;
+	return posts.level[idx];
 }
 
 int Map::GetPopulation(int idx) {
-	return posts[idx].populationLoad;
+	return posts.populationLoad[idx];
 }
 
 int Map::GetNextLevelPrice(int idx)
 {
-	return posts[idx].nextLevelPrice;
+	return posts.nextLevelPrice[idx];
 }
 
 int Map::GetPostIdx(int idx)
 {
-	return posts[idx].idx;
+	return posts.idx[idx];
+}
+
+int Map::TranslatePostIdx(size_t idx) const {
+	return postIdxConverter.Translate(idx);
 }
 
 Post::PostTypes Map::GetPostType(int idx) {
-	return posts[idx].type;
+	return posts.type[idx];
 }
 
-const std::unordered_set<int>& Map::GetMarkets() {
+const BitSet& Map::GetMarkets() {
 	return markets;
 }
 
-double Map::GetMarketK(int from, int idx, int homeIdx, double maxLoad, const std::unordered_set<int>& vBlackList, const std::unordered_set<edge> eBlackList, int dist, int onPathTo) {
-	std::unordered_set<int> forbidden = storages;
-	forbidden.insert(vBlackList.begin(), vBlackList.end());
-	double distanceTo = *GetDistance(from, idx, forbidden, eBlackList, dist, onPathTo);
-	double distanceFrom = GetDistance(idx, homeIdx);
+double Map::GetMarketK(int idx, int homeIdx, double maxLoad, double distanceTo, double distanceFrom) const {
 	double freeSpace = maxLoad;
-	freeSpace -= std::min(posts[idx].goodsLoad + posts[idx].refillRate * distanceTo, posts[idx].goodsCapacity);
+	freeSpace -= std::min(posts.goodsLoad[idx] + posts.refillRate[idx] * distanceTo, posts.goodsCapacity[idx]);
 	freeSpace = std::max(0.0, freeSpace);
-	double waitTime = freeSpace / posts[idx].refillRate;
-	double gain = maxLoad - posts[homeIdx].populationLoad * (distanceTo + distanceFrom + waitTime);
+	double waitTime = freeSpace / posts.refillRate[idx];
+	double gain = maxLoad - posts.populationLoad[homeIdx] * (distanceTo + distanceFrom + waitTime);
 	return gain / (distanceFrom + distanceTo + waitTime);
 }
 
-double Map::GetStorageK(int from, int idx, int homeIdx, double maxLoad, const std::unordered_set<int>& vBlackList, const std::unordered_set<edge> eBlackList, int dist, int onPathTo) {
-	std::unordered_set<int> forbidden = markets;
-	forbidden.insert(vBlackList.begin(), vBlackList.end());
-	double distanceTo = *GetDistance(from, idx, forbidden, eBlackList, dist, onPathTo);
-	double distanceFrom = GetDistance(idx, homeIdx);
+double Map::GetStorageK(int idx, double maxLoad, double distanceTo, double distanceFrom) const {
 	double freeSpace = maxLoad;
-	freeSpace -= std::min(posts[idx].armorLoad + posts[idx].refillRate * distanceTo, posts[idx].armorCapacity);
+	freeSpace -= std::min(posts.armorLoad[idx] + posts.refillRate[idx] * distanceTo, posts.armorCapacity[idx]);
 	freeSpace = std::max(0.0, freeSpace);
-	double waitTime = freeSpace / posts[idx].refillRate;
+	double waitTime = freeSpace / posts.refillRate[idx];
 	return maxLoad / (distanceFrom + distanceTo + waitTime);
 }
 
-const std::unordered_set<int>& Map::GetStorages() {
+const BitSet& Map::GetStorages() {
 	return storages;
 }
 
-const std::unordered_set<int>& Map::GetTowns() {
+const BitSet& Map::GetTowns() {
 	return towns;
 }
 
 void Map::Draw(SdlWindow& window) {
 	DrawEdges(window);
-	int k = 0;
-	for (int i = 0; i < posts.size(); ++i) {
+	DrawPosts(window, posts);
+}
+
+void Map::DrawPosts(SdlWindow& window, const PostTable& snapshot) {
+	for (size_t i = 0; i < snapshot.Size(); ++i) {
 		SDL_Texture* texture = nullptr;
 		int textureSide = TEXTURE_SIDE;
 		int offsetY = 0;
-		switch (posts[i].type) {
+		switch (snapshot.type[i]) {
 		case Post::PostTypes::NONE:
 			offsetY -= TEXTURE_SIDE * 0.3;
 			texture = textureManager["assets//none.png"];
 			break;
 		case Post::PostTypes::TOWN:
 
-			switch (posts[i].level) {
+			switch (snapshot.level[i]) {
 			case 1:
 				texture = textureManager["assets//town1.png"];
 				break;
@@ -168,7 +224,7 @@ void Map::Draw(SdlWindow& window) {
 		}
 		 
 		window.DrawTexture(adjacencyList[i].point.x, adjacencyList[i].point.y, textureSide, textureSide, texture, offsetY); 
-		switch (posts[i].type) {
+		switch (snapshot.type[i]) {
 		case Post::PostTypes::NONE:
 			break;
 		case Post::PostTypes::TOWN:
@@ -178,24 +234,24 @@ void Map::Draw(SdlWindow& window) {
 			window.SetDrawColor(255, 0, 0);
 			window.DrawRectangle(x, y, 15, textureSide, -textureSide);
 			window.SetDrawColor(0, 255, 0);
-			window.FillRectangle(x, y, 5, textureSide * (posts[i].goodsLoad / posts[i].goodsCapacity), -textureSide);
+			window.FillRectangle(x, y, 5, textureSide * (snapshot.goodsLoad[i] / snapshot.goodsCapacity[i]), -textureSide);
 			window.SetDrawColor(0, 0, 255);
-			window.FillRectangle(adjacencyList[i].point.x, adjacencyList[i].point.y, 5, textureSide * (posts[i].armorLoad / posts[i].armorCapacity), 5 - textureSide);
+			window.FillRectangle(adjacencyList[i].point.x, adjacencyList[i].point.y, 5, textureSide * (snapshot.armorLoad[i] / snapshot.armorCapacity[i]), 5 - textureSide);
 			window.SetDrawColor(255, 0, 255);
-			window.FillRectangle(adjacencyList[i].point.x, adjacencyList[i].point.y, 5, textureSide * (posts[i].populationLoad / posts[i].populationCapacity), -(5 + textureSide));
+			window.FillRectangle(adjacencyList[i].point.x, adjacencyList[i].point.y, 5, textureSide * (snapshot.populationLoad[i] / snapshot.populationCapacity[i]), -(5 + textureSide));
 		}
 			break;
 		case Post::PostTypes::MARKET:
 			window.SetDrawColor(255, 0, 0);
 			window.DrawRectangle(adjacencyList[i].point.x, adjacencyList[i].point.y, 5, textureSide, -textureSide / 1.5);
 			window.SetDrawColor(0, 255, 0);
-			window.FillRectangle(adjacencyList[i].point.x, adjacencyList[i].point.y, 5, textureSide * (posts[i].goodsLoad / posts[i].goodsCapacity), -textureSide / 1.5);
+			window.FillRectangle(adjacencyList[i].point.x, adjacencyList[i].point.y, 5, textureSide * (snapshot.goodsLoad[i] / snapshot.goodsCapacity[i]), -textureSide / 1.5);
 			break;
 		case Post::PostTypes::STORAGE:
 			window.SetDrawColor(255, 0, 0);
 			window.DrawRectangle(adjacencyList[i].point.x, adjacencyList[i].point.y, 5, textureSide, -textureSide / 1.5);
 			window.SetDrawColor(0, 0, 255);
-			window.FillRectangle(adjacencyList[i].point.x, adjacencyList[i].point.y, 5, textureSide * (posts[i].armorLoad / posts[i].armorCapacity), -textureSide / 1.5);
+			window.FillRectangle(adjacencyList[i].point.x, adjacencyList[i].point.y, 5, textureSide * (snapshot.armorLoad[i] / snapshot.armorCapacity[i]), -textureSide / 1.5);
 			break;
 		}
 	}
@@ -203,37 +259,248 @@ void Map::Draw(SdlWindow& window) {
 
 void Map::Update(const std::string& jsonDynamicData) {
 	try {
-		std::stringstream ss;
-		ss << jsonDynamicData;
-		Json::Document doc = Json::Load(ss);
-		auto nodeMap = doc.GetRoot().AsMap();
-		for (const auto& node : nodeMap["posts"].AsArray()) {
-			auto postMap = node.AsMap();
-			posts[TranslateVertexIdx(postMap["point_idx"].AsInt())] = { static_cast<Post::PostTypes>(postMap["type"].AsInt()),
-				static_cast<size_t>(postMap["idx"].AsInt()),
-				postMap["name"].AsString(), static_cast<size_t>(postMap["point_idx"].AsInt()) };
-			if (posts[TranslateVertexIdx(postMap["point_idx"].AsInt())].type == Post::PostTypes::TOWN) {
-				posts[TranslateVertexIdx(postMap["point_idx"].AsInt())].goodsCapacity = postMap["product_capacity"].AsDouble();
-				posts[TranslateVertexIdx(postMap["point_idx"].AsInt())].goodsLoad = postMap["product"].AsDouble();
-				posts[TranslateVertexIdx(postMap["point_idx"].AsInt())].armorCapacity = postMap["armor_capacity"].AsDouble();
-				posts[TranslateVertexIdx(postMap["point_idx"].AsInt())].armorLoad = postMap["armor"].AsDouble();
-				posts[TranslateVertexIdx(postMap["point_idx"].AsInt())].populationCapacity = postMap["population_capacity"].AsDouble();
-				posts[TranslateVertexIdx(postMap["point_idx"].AsInt())].populationLoad = postMap["population"].AsDouble();
-				posts[TranslateVertexIdx(postMap["point_idx"].AsInt())].level = postMap["level"].AsInt();
-				posts[TranslateVertexIdx(postMap["point_idx"].AsInt())].nextLevelPrice = postMap["next_level_price"].AsInt();
+		Json::Reader reader(jsonDynamicData);
+		reader.ReadDict([&](std::string_view key) {
+			if (key == "posts") {
+				std::vector<int> changed;
+				UpdatePosts(reader, changed);
 			}
-			else if(posts[TranslateVertexIdx(postMap["point_idx"].AsInt())].type == Post::PostTypes::MARKET) {
-				posts[TranslateVertexIdx(postMap["point_idx"].AsInt())].goodsCapacity = postMap["product_capacity"].AsDouble();
-				posts[TranslateVertexIdx(postMap["point_idx"].AsInt())].goodsLoad = postMap["product"].AsDouble();
-				posts[TranslateVertexIdx(postMap["point_idx"].AsInt())].refillRate = postMap["replenishment"].AsDouble();
+			else {
+				reader.Skip();
 			}
-			else if (posts[TranslateVertexIdx(postMap["point_idx"].AsInt())].type == Post::PostTypes::STORAGE) {
-				posts[TranslateVertexIdx(postMap["point_idx"].AsInt())].armorCapacity = postMap["armor_capacity"].AsDouble();
-				posts[TranslateVertexIdx(postMap["point_idx"].AsInt())].armorLoad = postMap["armor"].AsDouble();
+		});
+	}
+	catch (...) {
+		throw std::runtime_error{ "Map::Update error" };
+	}
+}
+
+const PostTable& Map::GetPosts() const {
+	return posts;
+}
+
+void Map::SetPosts(PostTable newPosts) {
+	posts = std::move(newPosts);
+}
+
+void Map::PredictPosts() {
+	for (size_t i = 0; i < posts.Size(); ++i) {
+		switch (posts.type[i]) {
+		case Post::PostTypes::MARKET:
+			posts.goodsLoad[i] = std::min(posts.goodsLoad[i] + posts.refillRate[i], posts.goodsCapacity[i]);
+			break;
+		case Post::PostTypes::STORAGE:
+			posts.armorLoad[i] = std::min(posts.armorLoad[i] + posts.armorRefillRate[i], posts.armorCapacity[i]);
+			break;
+		case Post::PostTypes::TOWN:
+			posts.goodsLoad[i] = std::max(0.0, posts.goodsLoad[i] - posts.populationLoad[i]);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+double Map::LoadTrain(int idx, double freeSpace) {
+	double& stock = posts.type[idx] == Post::PostTypes::MARKET ? posts.goodsLoad[idx] : posts.armorLoad[idx];
+	double taken = std::min(stock, freeSpace);
+	stock -= taken;
+	return taken;
+}
+
+void Map::BenchmarkScores(int home, double maxLoad, std::ostream& out) const {
+	std::vector<int> targets;
+	for (int i : markets) {
+		targets.push_back(i);
+	}
+	size_t origins = adjacencyList.size();
+	if (targets.empty()) {
+		return;
+	}
+	std::vector<double> distancesTo(origins * targets.size()); // row per origin vertex
+	std::vector<double> distancesFrom(targets.size());
+	for (size_t i = 0; i < targets.size(); ++i) {
+		distancesFrom[i] = GetDistance(targets[i], home);
+		for (size_t from = 0; from < origins; ++from) {
+			double distance = GetDistance(static_cast<int>(from), targets[i]);
+			distancesTo[from * targets.size() + i] = distance < 0 ? std::numeric_limits<double>::infinity() : distance;
+		}
+	}
+	ScoreFields fields{ posts.goodsLoad.data(), posts.goodsCapacity.data(), posts.refillRate.data() };
+	double consumption = posts.populationLoad[home];
+	std::vector<double> k(targets.size());
+	std::vector<int> reference(origins);
+
+	auto measure = [&](const char* name, auto score) {
+		size_t differences = 0;
+		for (size_t from = 0; from < origins; ++from) {
+			differences += score(distancesTo.data() + from * targets.size()) != reference[from];
+		}
+		auto before = std::chrono::high_resolution_clock::now();
+		size_t checksum = 0;
+		for (size_t round = 0; round < SCORE_ROUNDS; ++round) {
+			for (size_t from = 0; from < origins; ++from) {
+				checksum += score(distancesTo.data() + from * targets.size());
 			}
 		}
+		auto after = std::chrono::high_resolution_clock::now();
+		double ns = std::chrono::duration<double, std::nano>(after - before).count();
+		out << name << ": " << ns / (SCORE_ROUNDS * origins) << " ns per " << targets.size() << " markets, "
+			<< differences << " different choices, checksum " << checksum << std::endl;
+	};
+	auto perPost = [&](const double* distanceTo) { // loop GetBestMarket ran before the batch kernel
+		int best = -1;
+		for (size_t i = 0; i < targets.size(); ++i) {
+			k[i] = distanceTo[i] == std::numeric_limits<double>::infinity() ? -std::numeric_limits<double>::infinity() :
+				GetMarketK(targets[i], home, maxLoad, distanceTo[i], distancesFrom[i]);
+			if (best == -1 || k[i] > k[best]) {
+				best = static_cast<int>(i);
+			}
+		}
+		return best;
+	};
+	for (size_t from = 0; from < origins; ++from) {
+		reference[from] = perPost(distancesTo.data() + from * targets.size());
+	}
+	measure("per post GetMarketK", perPost);
+	measure("scalar kernel", [&](const double* distanceTo) {
+		return ScoreCandidatesScalar(fields, maxLoad, consumption, targets.data(), distanceTo, distancesFrom.data(), targets.size(), k.data());
+	});
+	if (!HasAvx2()) {
+		out << "AVX2 kernel: not supported by processor" << std::endl;
+		return;
+	}
+	measure("AVX2 kernel", [&](const double* distanceTo) {
+		return ScoreCandidatesAvx2(fields, maxLoad, consumption, targets.data(), distanceTo, distancesFrom.data(), targets.size(), k.data());
+	});
+}
+
+void Map::UpdatePosts(Json::Reader& postsArray, std::vector<int>& changed) {
+	try {
+		postsArray.ReadArray([&]() {
+			Post post{ Post::PostTypes::NONE, 0, 0 };
+			Post decoded{ Post::PostTypes::NONE, 0, 0 };
+			std::string_view name;
+			postsArray.ReadDict([&](std::string_view key) {
+				if (key == "type") {
+					decoded.type = static_cast<Post::PostTypes>(postsArray.ReadInt());
+				}
+				else if (key == "idx") {
+					decoded.idx = static_cast<size_t>(postsArray.ReadInt());
+				}
+				else if (key == "name") {
+					name = postsArray.ReadString();
+				}
+				else if (key == "point_idx") {
+					decoded.pointIdx = static_cast<size_t>(postsArray.ReadInt());
+				}
+				else if (key == "product_capacity") {
+					decoded.goodsCapacity = postsArray.ReadDouble();
+				}
+				else if (key == "product") {
+					decoded.goodsLoad = postsArray.ReadDouble();
+				}
+				else if (key == "armor_capacity") {
+					decoded.armorCapacity = postsArray.ReadDouble();
+				}
+				else if (key == "armor") {
+					decoded.armorLoad = postsArray.ReadDouble();
+				}
+				else if (key == "population_capacity") {
+					decoded.populationCapacity = postsArray.ReadDouble();
+				}
+				else if (key == "population") {
+					decoded.populationLoad = postsArray.ReadDouble();
+				}
+				else if (key == "level") {
+					decoded.level = postsArray.ReadInt();
+				}
+				else if (key == "next_level_price") {
+					decoded.nextLevelPrice = postsArray.ReadInt();
+				}
+				else if (key == "replenishment") {
+					decoded.refillRate = postsArray.ReadDouble();
+				}
+				else {
+					postsArray.Skip();
+				}
+			});
+			// only fields meaningful for the post type are taken, the rest keep their defaults
+			post.type = decoded.type;
+			post.idx = decoded.idx;
+			post.pointIdx = decoded.pointIdx;
+			if (post.type == Post::PostTypes::TOWN) {
+				post.goodsCapacity = decoded.goodsCapacity;
+				post.goodsLoad = decoded.goodsLoad;
+				post.armorCapacity = decoded.armorCapacity;
+				post.armorLoad = decoded.armorLoad;
+				post.populationCapacity = decoded.populationCapacity;
+				post.populationLoad = decoded.populationLoad;
+				post.level = decoded.level;
+				post.nextLevelPrice = decoded.nextLevelPrice;
+			}
+			else if (post.type == Post::PostTypes::MARKET) {
+				post.goodsCapacity = decoded.goodsCapacity;
+				post.goodsLoad = decoded.goodsLoad;
+				post.refillRate = decoded.refillRate;
+			}
+			else if (post.type == Post::PostTypes::STORAGE) {
+				post.armorCapacity = decoded.armorCapacity;
+				post.armorLoad = decoded.armorLoad;
+				post.armorRefillRate = decoded.refillRate;
+			}
+			int vertex = TranslatePostIdx(post.idx); // layer 0 tied every post to its point
+			if (posts.name[vertex] != name) { // unchanged name is not copied
+				posts.name[vertex] = name;
+			}
+			if (!posts.Matches(vertex, post)) {
+				changed.push_back(vertex);
+			}
+			posts.Set(vertex, post);
+		});
 	}
 	catch (...) {
 		throw std::runtime_error{ "Map::Update error" };
 	}
 }
+
+size_t PostTable::Size() const {
+	return type.size();
+}
+
+void PostTable::Resize(size_t size) {
+	type.resize(size, Post::PostTypes::NONE);
+	idx.resize(size, 0);
+	refillRate.resize(size, 0.0);
+	armorRefillRate.resize(size, 0.0);
+	goodsCapacity.resize(size, 0.0);
+	goodsLoad.resize(size, 0.0);
+	armorCapacity.resize(size, 0.0);
+	armorLoad.resize(size, 0.0);
+	populationCapacity.resize(size, 0.0);
+	populationLoad.resize(size, 0.0);
+	level.resize(size, 1);
+	nextLevelPrice.resize(size, 0);
+	name.resize(size);
+}
+
+bool PostTable::Matches(int vertex, const Post& post) const {
+	return type[vertex] == post.type && goodsLoad[vertex] == post.goodsLoad && armorLoad[vertex] == post.armorLoad && populationLoad[vertex] == post.populationLoad
+		&& goodsCapacity[vertex] == post.goodsCapacity && armorCapacity[vertex] == post.armorCapacity && populationCapacity[vertex] == post.populationCapacity
+		&& refillRate[vertex] == post.refillRate && armorRefillRate[vertex] == post.armorRefillRate && level[vertex] == post.level && nextLevelPrice[vertex] == post.nextLevelPrice;
+}
+
+void PostTable::Set(int vertex, const Post& post) {
+	type[vertex] = post.type;
+	idx[vertex] = post.idx;
+	refillRate[vertex] = post.refillRate;
+	armorRefillRate[vertex] = post.armorRefillRate;
+	goodsCapacity[vertex] = post.goodsCapacity;
+	goodsLoad[vertex] = post.goodsLoad;
+	armorCapacity[vertex] = post.armorCapacity;
+	armorLoad[vertex] = post.armorLoad;
+	populationCapacity[vertex] = post.populationCapacity;
+	populationLoad[vertex] = post.populationLoad;
+	level[vertex] = post.level;
+	nextLevelPrice[vertex] = post.nextLevelPrice;
+}
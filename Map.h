@@ -1,18 +1,25 @@
 #pragma once
 #include "graph.h"
+#include "ScoreKernel.h"
+#include <ostream>
+
+namespace Json {
+	class Reader;
+}
 
 struct Event {};
 
-struct Post {
+struct Post { // one post as read from layer 1
 	enum class PostTypes {
 		NONE = 0,
 		TOWN,
 		MARKET,
 		STORAGE
 	};
-	Post(PostTypes type, size_t idx, const std::string& name, size_t pointIdx) : type{ type }, idx{ idx }, name{ name }, pointIdx{ pointIdx } {
+	Post(PostTypes type, size_t idx, size_t pointIdx) : type{ type }, idx{ idx }, pointIdx{ pointIdx } {
 	}
 	double refillRate = 0.0;
+	double armorRefillRate = 0.0;
 	double goodsCapacity = 0.0;
 	double goodsLoad = 0.0;
 	double armorCapacity = 0.0;
@@ -23,35 +30,64 @@ struct Post {
 	int nextLevelPrice = 0;
 	PostTypes type;
 	size_t idx;
-	std::string name;
 	size_t pointIdx;
 };
 
+struct PostTable { // posts by vertex idx, one array per field, so scans over posts read only fields they need
+	std::vector<Post::PostTypes> type;
+	std::vector<size_t> idx;
+	std::vector<double> refillRate;
+	std::vector<double> armorRefillRate; // storage replenishment, only for predicting next turn
+	std::vector<double> goodsCapacity;
+	std::vector<double> goodsLoad;
+	std::vector<double> armorCapacity;
+	std::vector<double> armorLoad;
+	std::vector<double> populationCapacity;
+	std::vector<double> populationLoad;
+	std::vector<int> level;
+	std::vector<int> nextLevelPrice;
+	std::vector<std::string> name;
+	size_t Size() const;
+	void Resize(size_t size); // added posts are of type NONE
+	bool Matches(int vertex, const Post& post) const; // same type, loads, capacities, level and price
+	void Set(int vertex, const Post& post); // every field but name
+};
+
 class Map : public Graph {
 private:
 	TextureManager& textureManager;
-	std::map<size_t, size_t> postIdxConverter;
-	std::vector<Post> posts;
-	std::unordered_set<int> markets;
-	std::unordered_set<int> storages;
-	std::unordered_set<int> towns;
+	IdRemap postIdxConverter; // server post idx -> local vertex idx
+	PostTable posts;
+	BitSet markets;
+	BitSet storages;
+	BitSet towns;
 public:
-	Map(const std::string& jsonStructureData, const std::string& jsonCoordinatesData, const std::string& jsonDynamicData, TextureManager& textureManager);
-	std::pair<int, double> GetBestMarket(int from, int home, double maxLoad, const std::unordered_set<int>& vBlackList, const std::unordered_set<edge> eBlackList, int dist = 0, int onPathTo = -1);
-	std::pair<int, double> GetBestStorage(int from, int home, double maxLoad, const std::unordered_set<int>& vBlackList, const std::unordered_set<edge> eBlackList, int dist = 0, int onPathTo = -1);
+	Map(const std::string& jsonStructureData, const std::string& jsonCoordinatesData, const std::string& jsonDynamicData, TextureManager& textureManager, bool precomputeDistances = true);
+	std::pair<int, double> GetBestMarket(int from, int home, double maxLoad, const BitSet& vBlackList, const BitSet& eBlackList, int dist = 0, int onPathTo = -1);
+	std::pair<int, double> GetBestStorage(int from, int home, double maxLoad, const BitSet& vBlackList, const BitSet& eBlackList, int dist = 0, int onPathTo = -1);
 	int GetArmor(int idx);
 	int GetProduct(int idx);
 	int GetLevel(int idx);
 	int GetPopulation(int idx);
 	int GetNextLevelPrice(int idx);
 	int GetPostIdx(int idx);
+	int TranslatePostIdx(size_t idx) const;
 	Post::PostTypes GetPostType(int idx);
-	const std::unordered_set<int>& GetMarkets();
-	const std::unordered_set<int>& GetStorages();
-	const std::unordered_set<int>& GetTowns();
+	const BitSet& GetMarkets();
+	const BitSet& GetStorages();
+	const BitSet& GetTowns();
 	void Draw(SdlWindow& window) override;
+	void DrawPosts(SdlWindow& window, const PostTable& snapshot); // posts copied from GetPosts, safe to draw while posts are updated
 	void Update(const std::string& jsonDynamicData); // updated postsInfo
+	void UpdatePosts(Json::Reader& postsArray, std::vector<int>& changed); // updates postsInfo from "posts" array of layer 1, appends vertices of changed posts
+	const PostTable& GetPosts() const;
+	void SetPosts(PostTable newPosts); // restores posts saved by GetPosts
+	void PredictPosts(); // advances posts by one tick: markets and storages refill, towns consume product
+	double LoadTrain(int idx, double freeSpace); // predicted goods taken from market or storage by train standing there
+	void BenchmarkScores(int home, double maxLoad, std::ostream& out) const; // prints speed of scoring every market from every vertex per post and by batch kernels
 private:
-	double GetMarketK(int from, int idx, int homeIdx, double maxLoad, const std::unordered_set<int>& vBlackList, const std::unordered_set<edge> eBlackList, int dist = 0, int onPathTo = -1);
-	double GetStorageK(int from, int idx, int homeIdx, double maxLoad, const std::unordered_set<int>& vBlackList, const std::unordered_set<edge> eBlackList, int dist = 0, int onPathTo = -1);
+	std::pair<int, double> GetBestPost(const BitSet& kind, const BitSet& otherKind, const ScoreFields& fields, double consumption,
+		int from, int home, double maxLoad, const BitSet& vBlackList, const BitSet& eBlackList, int dist, int onPathTo); // kind is markets or storages
+	double GetMarketK(int idx, int homeIdx, double maxLoad, double distanceTo, double distanceFrom) const; // non-increasing in distanceTo
+	double GetStorageK(int idx, double maxLoad, double distanceTo, double distanceFrom) const; // non-increasing in distanceTo
 };
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include "NetworkLog.h"
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+
+// log: magic, version, frames, index, index offset, index magic; numbers are little endian
+// frame: code u32, data size u32, microseconds since recording start u64, connection u16, direction u8, data
+// index: exchanges count u64, then request frame offset u64 and response frame offset u64 of every exchange
+constexpr char LOG_MAGIC[] = "WGNL";
+constexpr char INDEX_MAGIC[] = "WGNI";
+constexpr uint32_t LOG_VERSION = 1;
+constexpr size_t HEADER_SIZE = 8;
+constexpr size_t FRAME_HEADER_SIZE = 19;
+constexpr size_t TRAILER_SIZE = 12;
+constexpr uint8_t REQUEST = 0;
+constexpr uint8_t RESPONSE = 1;
+
+static void Put(std::string& buffer, uint64_t value, int bytes) {
+	for (int i = 0; i < bytes; ++i) {
+		buffer += static_cast<char>(value & 0xFF);
+		value >>= 8;
+	}
+}
+
+static uint64_t Get(const std::string& buffer, size_t offset, int bytes) {
+	uint64_t value = 0;
+	for (int i = bytes - 1; i >= 0; --i) {
+		value = (value << 8) | static_cast<uint8_t>(buffer[offset + i]);
+	}
+	return value;
+}
+
+NetworkLog::NetworkLog(const std::string& path, Mode mode) : mode{ mode } {
+	if (mode == Mode::RECORD) {
+		out.open(path, std::ios::binary | std::ios::trunc);
+		if (!out) {
+			throw std::runtime_error{ "can't create network log " + path };
+		}
+		std::string header{ LOG_MAGIC, 4 };
+		Put(header, LOG_VERSION, 4);
+		out.write(header.data(), header.size());
+		written = header.size();
+		start = std::chrono::steady_clock::now();
+		return;
+	}
+	std::ifstream in(path, std::ios::binary);
+	if (!in) {
+		throw std::runtime_error{ "can't open network log " + path };
+	}
+	log.assign(std::istreambuf_iterator<char>{ in }, std::istreambuf_iterator<char>{});
+	if (log.size() < HEADER_SIZE || log.compare(0, 4, LOG_MAGIC) != 0 || Get(log, 4, 4) != LOG_VERSION) {
+		throw std::runtime_error{ path + " is not a network log" };
+	}
+	if (!ReadIndex()) {
+		exchanges.clear();
+		ScanFrames();
+	}
+	served.assign(exchanges.size(), false);
+	for (size_t i = 0; i < exchanges.size(); ++i) {
+		const Exchange& exchange = exchanges[i];
+		uint32_t code = static_cast<uint32_t>(Get(log, exchange.request, 4));
+		size_t size = Get(log, exchange.request + 4, 4);
+		byRequest[GetKey(code, log.data() + exchange.request + FRAME_HEADER_SIZE, size)].push_back(i);
+		byCode[code].push_back(i);
+		lastTime = std::max(lastTime, Get(log, exchange.response + 8, 8));
+	}
+}
+
+NetworkLog::~NetworkLog() {
+	if (mode == Mode::RECORD) {
+		WriteIndex();
+	}
+}
+
+bool NetworkLog::IsReplaying() const {
+	return mode == Mode::REPLAY;
+}
+
+void NetworkLog::RecordRequest(int connection, uint32_t code, const char* data, size_t size) {
+	std::lock_guard<std::mutex> guard(lock);
+	unanswered[connection].push_back(written);
+	Write(REQUEST, connection, code, data, size);
+}
+
+void NetworkLog::RecordResponse(int connection, uint32_t code, const char* data, size_t size) {
+	std::lock_guard<std::mutex> guard(lock);
+	auto& requests = unanswered[connection];
+	if (!requests.empty()) { // server answers requests of connection in order
+		exchanges.push_back({ requests.front(), written });
+		requests.pop_front();
+	}
+	Write(RESPONSE, connection, code, data, size);
+}
+
+std::string NetworkLog::Answer(uint32_t code, const char* data, size_t size) {
+	std::lock_guard<std::mutex> guard(lock);
+	auto take = [this](std::deque<size_t>& queue) {
+		while (!queue.empty() && served[queue.front()]) {
+			queue.pop_front();
+		}
+		if (queue.empty()) {
+			return false;
+		}
+		served[queue.front()] = true;
+		return true;
+	};
+	auto sameRequest = byRequest.find(GetKey(code, data, size));
+	size_t exchange;
+	if (sameRequest != byRequest.end() && take(sameRequest->second)) {
+		exchange = sameRequest->second.front();
+	}
+	else if (take(byCode[code])) { // e.g. move the recorded client didn't make, any answer to such request will do
+		exchange = byCode[code].front();
+	}
+	else {
+		throw std::runtime_error{ "network log has no response left for request " + std::to_string(code) };
+	}
+	size_t response = exchanges[exchange].response;
+	size_t responseSize = Get(log, response + 4, 4);
+	std::string frame = log.substr(response, 4);
+	Put(frame, responseSize, 4);
+	frame.append(log, response + FRAME_HEADER_SIZE, responseSize);
+	return frame;
+}
+
+double NetworkLog::GetRecordedSeconds() const {
+	return lastTime / 1e6;
+}
+
+void NetworkLog::Write(uint8_t direction, int connection, uint32_t code, const char* data, size_t size) {
+	lastTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	std::string header;
+	header.reserve(FRAME_HEADER_SIZE);
+	Put(header, code, 4);
+	Put(header, size, 4);
+	Put(header, lastTime, 8);
+	Put(header, connection, 2);
+	Put(header, direction, 1);
+	out.write(header.data(), header.size());
+	out.write(data, size);
+	written += header.size() + size;
+}
+
+void NetworkLog::WriteIndex() {
+	std::lock_guard<std::mutex> guard(lock);
+	std::string index;
+	index.reserve(8 + exchanges.size() * 16 + TRAILER_SIZE);
+	Put(index, exchanges.size(), 8);
+	for (const Exchange& exchange : exchanges) {
+		Put(index, exchange.request, 8);
+		Put(index, exchange.response, 8);
+	}
+	Put(index, written, 8);
+	index.append(INDEX_MAGIC, 4);
+	out.write(index.data(), index.size());
+}
+
+bool NetworkLog::ReadIndex() {
+	if (log.size() < HEADER_SIZE + 8 + TRAILER_SIZE || log.compare(log.size() - 4, 4, INDEX_MAGIC) != 0) {
+		return false;
+	}
+	size_t indexOffset = Get(log, log.size() - TRAILER_SIZE, 8);
+	if (indexOffset < HEADER_SIZE || indexOffset + 8 > log.size() - TRAILER_SIZE) {
+		return false;
+	}
+	size_t count = Get(log, indexOffset, 8);
+	if (count > (log.size() - TRAILER_SIZE - indexOffset - 8) / 16) {
+		return false;
+	}
+	for (size_t i = 0; i < count; ++i) {
+		Exchange exchange{ Get(log, indexOffset + 8 + i * 16, 8), Get(log, indexOffset + 16 + i * 16, 8) };
+		for (size_t frame : { exchange.request, exchange.response }) {
+			if (frame < HEADER_SIZE || frame + FRAME_HEADER_SIZE > indexOffset || frame + FRAME_HEADER_SIZE + Get(log, frame + 4, 4) > indexOffset) {
+				return false;
+			}
+		}
+		exchanges.push_back(exchange);
+	}
+	return true;
+}
+
+void NetworkLog::ScanFrames() {
+	size_t offset = HEADER_SIZE;
+	while (offset + FRAME_HEADER_SIZE <= log.size()) {
+		size_t size = Get(log, offset + 4, 4);
+		if (offset + FRAME_HEADER_SIZE + size > log.size()) {
+			break; // cut off by killed recording
+		}
+		int connection = static_cast<int>(Get(log, offset + 16, 2));
+		if (static_cast<uint8_t>(log[offset + 18]) == REQUEST) {
+			unanswered[connection].push_back(offset);
+		}
+		else if (!unanswered[connection].empty()) {
+			exchanges.push_back({ unanswered[connection].front(), offset });
+			unanswered[connection].pop_front();
+		}
+		offset += FRAME_HEADER_SIZE + size;
+	}
+}
+
+std::string NetworkLog::GetKey(uint32_t code, const char* data, size_t size) const {
+	std::string key;
+	key.reserve(4 + size);
+	Put(key, code, 4);
+	key.append(data, size);
+	return key;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <fstream>
+#include <chrono>
+#include <mutex>
+#include <cstdint>
+
+// Binary log of every request and response frame of all connections. Recording appends frames as they go over
+// the network and writes an index of request/response pairs on close. Replaying loads the log and answers
+// each request with the response recorded for the same request, so no server is needed.
+class NetworkLog {
+public:
+	enum class Mode {
+		RECORD,
+		REPLAY
+	};
+	NetworkLog(const std::string& path, Mode mode); // throws if file can't be opened or is not a network log
+	NetworkLog(const NetworkLog&) = delete;
+	NetworkLog& operator=(const NetworkLog&) = delete;
+	~NetworkLog(); // recording writes the index
+	bool IsReplaying() const;
+	void RecordRequest(int connection, uint32_t code, const char* data, size_t size);
+	void RecordResponse(int connection, uint32_t code, const char* data, size_t size);
+	std::string Answer(uint32_t code, const char* data, size_t size); // response frame as server sent it, throws if log has none left for this request
+	double GetRecordedSeconds() const; // from start of recording to the last response
+private:
+	struct Exchange {
+		size_t request; // offsets of frames in log
+		size_t response;
+	};
+	void Write(uint8_t direction, int connection, uint32_t code, const char* data, size_t size);
+	void WriteIndex();
+	bool ReadIndex(); // false if log has no valid index, e.g. recording was killed
+	void ScanFrames(); // pairs requests with responses by connection in frame order
+	std::string GetKey(uint32_t code, const char* data, size_t size) const;
+	Mode mode;
+	std::mutex lock;
+	// recording
+	std::ofstream out;
+	size_t written = 0;
+	std::chrono::steady_clock::time_point start;
+	std::unordered_map<int, std::deque<size_t>> unanswered; // request frames by connection
+	// replaying
+	std::string log;
+	std::unordered_map<std::string, std::deque<size_t>> byRequest; // exchanges by code and data of request
+	std::unordered_map<uint32_t, std::deque<size_t>> byCode; // exchanges by request code, for requests never recorded
+	std::vector<char> served;
+	// both
+	std::vector<Exchange> exchanges;
+	uint64_t lastTime = 0;
+};
@@ -0,0 +1,86 @@
+#include "ReservationTable.h"
+#include <stdexcept>
+
+static uint64_t SegmentKey(int lineIdx, int offset) {
+	return static_cast<uint64_t>(static_cast<uint32_t>(lineIdx)) << 32 | static_cast<uint32_t>(offset);
+}
+
+ReservationTable::ReservationTable(int window) {
+	Reset(window);
+}
+
+void ReservationTable::Reset(int window) {
+	positions.resize(window + 1);
+	segments.resize(window + 1);
+	for (auto& tick : positions) {
+		tick.Clear();
+	}
+	for (auto& tick : segments) {
+		tick.Clear();
+	}
+}
+
+int ReservationTable::GetWindow() const {
+	return static_cast<int>(positions.size()) - 1;
+}
+
+void ReservationTable::ReservePosition(uint64_t position, int tick) {
+	if (IsInWindow(tick)) {
+		positions[tick].Insert(position);
+	}
+}
+
+void ReservationTable::ReservePosition(uint64_t position, int fromTick, int toTick) {
+	for (int tick = fromTick; tick <= toTick; ++tick) {
+		ReservePosition(position, tick);
+	}
+}
+
+void ReservationTable::ReleasePosition(uint64_t position, int tick) {
+	if (IsInWindow(tick)) {
+		positions[tick].Erase(position);
+	}
+}
+
+bool ReservationTable::IsPositionReserved(uint64_t position, int tick) const {
+	return IsInWindow(tick) && positions[tick].Contains(position);
+}
+
+void ReservationTable::ReserveSegment(int lineIdx, int offset, int tick) {
+	if (IsInWindow(tick)) {
+		segments[tick].Insert(SegmentKey(lineIdx, offset));
+	}
+}
+
+bool ReservationTable::IsSegmentReserved(int lineIdx, int offset, int tick) const {
+	return IsInWindow(tick) && segments[tick].Contains(SegmentKey(lineIdx, offset));
+}
+
+bool ReservationTable::ConflictsWith(const ReservationTable& before, const ReservationTable& after) const {
+	CheckWindow(before, after);
+	for (size_t tick = 0; tick < positions.size(); ++tick) {
+		if (positions[tick].ContainsAdded(before.positions[tick], after.positions[tick])
+			|| segments[tick].ContainsAdded(before.segments[tick], after.segments[tick])) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void ReservationTable::ApplyChanges(const ReservationTable& before, const ReservationTable& after) {
+	CheckWindow(before, after);
+	for (size_t tick = 0; tick < positions.size(); ++tick) {
+		positions[tick].ApplyChanges(before.positions[tick], after.positions[tick]);
+		segments[tick].ApplyChanges(before.segments[tick], after.segments[tick]);
+	}
+}
+
+bool ReservationTable::IsInWindow(int tick) const {
+	return tick >= 0 && tick < static_cast<int>(positions.size());
+}
+
+void ReservationTable::CheckWindow(const ReservationTable& before, const ReservationTable& after) const {
+	if (before.GetWindow() != GetWindow() || after.GetWindow() != GetWindow()) {
+		throw std::runtime_error{ "reservation windows differ" };
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "FlatHash.h"
+#include <vector>
+
+class ReservationTable { // space-time reservations of train positions and unit line segments, tick 0 is current turn
+public:
+	explicit ReservationTable(int window = 0);
+	void Reset(int window); // drops all reservations, keeps ticks 0..window
+	int GetWindow() const;
+	void ReservePosition(uint64_t position, int tick); // ticks outside window are ignored
+	void ReservePosition(uint64_t position, int fromTick, int toTick); // every tick in [fromTick, toTick]
+	void ReleasePosition(uint64_t position, int tick);
+	bool IsPositionReserved(uint64_t position, int tick) const; // false outside window
+	void ReserveSegment(int lineIdx, int offset, int tick); // segment [offset, offset + 1] of line is crossed between tick and tick + 1
+	bool IsSegmentReserved(int lineIdx, int offset, int tick) const;
+	bool ConflictsWith(const ReservationTable& before, const ReservationTable& after) const; // true if something reserved in after but not in before is reserved here
+	void ApplyChanges(const ReservationTable& before, const ReservationTable& after); // repeats reservations made and released between before and after
+private:
+	bool IsInWindow(int tick) const;
+	void CheckWindow(const ReservationTable& before, const ReservationTable& after) const; // throws if windows differ
+	std::vector<FlatHashSet> positions; // by tick
+	std::vector<FlatHashSet> segments; // by tick, line idx in high half of key
+};
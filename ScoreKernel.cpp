@@ -0,0 +1,134 @@
+#include "ScoreKernel.h"
+#include <algorithm>
+#include <limits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SCORE_KERNEL_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+constexpr size_t LANES = 4;
+
+// operations in the same order as Map::GetMarketK and Map::GetStorageK, so every K matches them bit for bit
+template <bool consuming>
+static double ScoreOne(const ScoreFields& fields, double maxLoad, double consumption, int target, double distanceTo, double distanceFrom) {
+	if (distanceTo == std::numeric_limits<double>::infinity()) {
+		return -std::numeric_limits<double>::infinity();
+	}
+	double freeSpace = maxLoad;
+	freeSpace -= std::min(fields.load[target] + fields.refillRate[target] * distanceTo, fields.capacity[target]);
+	freeSpace = std::max(0.0, freeSpace);
+	double waitTime = freeSpace / fields.refillRate[target];
+	double time = distanceFrom + distanceTo + waitTime;
+	return consuming ? (maxLoad - consumption * time) / time : maxLoad / time;
+}
+
+static int FindBest(const double* k, size_t count) { // first maximum, like the scan in SelectBest
+	int best = -1;
+	for (size_t i = 0; i < count; ++i) {
+		if (best == -1 || k[i] > k[best]) {
+			best = static_cast<int>(i);
+		}
+	}
+	return best;
+}
+
+template <bool consuming>
+static void ScoreTail(const ScoreFields& fields, double maxLoad, double consumption,
+		const int* targets, const double* distanceTo, const double* distanceFrom, size_t from, size_t count, double* k) {
+	for (size_t i = from; i < count; ++i) {
+		k[i] = ScoreOne<consuming>(fields, maxLoad, consumption, targets[i], distanceTo[i], distanceFrom[i]);
+	}
+}
+
+int ScoreCandidatesScalar(const ScoreFields& fields, double maxLoad, double consumption,
+		const int* targets, const double* distanceTo, const double* distanceFrom, size_t count, double* k) {
+	if (consumption != 0) {
+		ScoreTail<true>(fields, maxLoad, consumption, targets, distanceTo, distanceFrom, 0, count, k);
+	}
+	else {
+		ScoreTail<false>(fields, maxLoad, consumption, targets, distanceTo, distanceFrom, 0, count, k);
+	}
+	return FindBest(k, count);
+}
+
+#ifdef SCORE_KERNEL_AVX2
+template <bool consuming>
+AVX2_TARGET static void ScoreLanes(const ScoreFields& fields, double maxLoad, double consumption,
+		const int* targets, const double* distanceTo, const double* distanceFrom, size_t count, double* k) {
+	const __m256d max = _mm256_set1_pd(maxLoad);
+	const __m256d rate = _mm256_set1_pd(consumption);
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d unreachable = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+	const __m256d worst = _mm256_set1_pd(-std::numeric_limits<double>::infinity());
+	size_t i = 0;
+	for (; i + LANES <= count; i += LANES) {
+		__m128i idx = _mm_loadu_si128(reinterpret_cast<const __m128i*>(targets + i));
+		__m256d load = _mm256_i32gather_pd(fields.load, idx, sizeof(double));
+		__m256d capacity = _mm256_i32gather_pd(fields.capacity, idx, sizeof(double));
+		__m256d refillRate = _mm256_i32gather_pd(fields.refillRate, idx, sizeof(double));
+		__m256d to = _mm256_loadu_pd(distanceTo + i);
+		__m256d from = _mm256_loadu_pd(distanceFrom + i);
+		__m256d stock = _mm256_add_pd(load, _mm256_mul_pd(refillRate, to));
+		stock = _mm256_min_pd(capacity, stock); // operand order of std::min(stock, capacity)
+		__m256d freeSpace = _mm256_max_pd(_mm256_sub_pd(max, stock), zero); // operand order of std::max(0.0, freeSpace)
+		__m256d time = _mm256_add_pd(_mm256_add_pd(from, to), _mm256_div_pd(freeSpace, refillRate));
+		__m256d gain = consuming ? _mm256_sub_pd(max, _mm256_mul_pd(rate, time)) : max;
+		__m256d result = _mm256_div_pd(gain, time);
+		result = _mm256_blendv_pd(result, worst, _mm256_cmp_pd(to, unreachable, _CMP_EQ_OQ));
+		_mm256_storeu_pd(k + i, result);
+	}
+	_mm256_zeroupper(); // tail and caller are SSE code, dirty upper halves would slow every instruction there
+	ScoreTail<consuming>(fields, maxLoad, consumption, targets, distanceTo, distanceFrom, i, count, k);
+}
+
+int ScoreCandidatesAvx2(const ScoreFields& fields, double maxLoad, double consumption,
+		const int* targets, const double* distanceTo, const double* distanceFrom, size_t count, double* k) {
+	if (consumption != 0) {
+		ScoreLanes<true>(fields, maxLoad, consumption, targets, distanceTo, distanceFrom, count, k);
+	}
+	else {
+		ScoreLanes<false>(fields, maxLoad, consumption, targets, distanceTo, distanceFrom, count, k);
+	}
+	return FindBest(k, count);
+}
+
+bool HasAvx2() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6; // OSXSAVE, then XMM and YMM state enabled
+	if (!osSavesYmm) {
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#else
+int ScoreCandidatesAvx2(const ScoreFields& fields, double maxLoad, double consumption,
+		const int* targets, const double* distanceTo, const double* distanceFrom, size_t count, double* k) {
+	return ScoreCandidatesScalar(fields, maxLoad, consumption, targets, distanceTo, distanceFrom, count, k);
+}
+
+bool HasAvx2() {
+	return false;
+}
+#endif
+
+int ScoreCandidates(const ScoreFields& fields, double maxLoad, double consumption,
+		const int* targets, const double* distanceTo, const double* distanceFrom, size_t count, double* k) {
+	static const bool avx2 = HasAvx2();
+	if (avx2) {
+		return ScoreCandidatesAvx2(fields, maxLoad, consumption, targets, distanceTo, distanceFrom, count, k);
+	}
+	return ScoreCandidatesScalar(fields, maxLoad, consumption, targets, distanceTo, distanceFrom, count, k);
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+
+struct ScoreFields { // post arrays indexed by vertex, goods ones for markets, armor ones for storages
+	const double* load;
+	const double* capacity;
+	const double* refillRate;
+};
+
+// Writes to k the K Map::GetMarketK gives for every candidate, storages are scored with zero consumption,
+// candidate with infinite distanceTo is unreachable and gets -infinity. Returns position of the first candidate
+// with maximal K, -1 when count is 0. Uses AVX2 when the processor has it, results are the same either way.
+int ScoreCandidates(const ScoreFields& fields, double maxLoad, double consumption,
+	const int* targets, const double* distanceTo, const double* distanceFrom, size_t count, double* k);
+int ScoreCandidatesScalar(const ScoreFields& fields, double maxLoad, double consumption,
+	const int* targets, const double* distanceTo, const double* distanceFrom, size_t count, double* k);
+int ScoreCandidatesAvx2(const ScoreFields& fields, double maxLoad, double consumption,
+	const int* targets, const double* distanceTo, const double* distanceFrom, size_t count, double* k); // only if HasAvx2
+bool HasAvx2();
@@ -0,0 +1,78 @@
+#include "SearchWorkspace.h"
+#include <algorithm>
+
+static bool HeapComparator(const SearchQueue::Entry& lhs, const SearchQueue::Entry& rhs) {
+	return lhs.key > rhs.key;
+}
+
+void SearchQueue::Reset(size_t bucketsCount) {
+	heap.clear();
+	for (size_t i = 0; i < usedBuckets; ++i) {
+		buckets[i].clear();
+	}
+	if (buckets.size() < bucketsCount) {
+		buckets.resize(bucketsCount);
+	}
+	usedBuckets = bucketsCount;
+	currentKey = 0;
+	count = 0;
+}
+
+void SearchQueue::Push(const Entry& entry) {
+	++count;
+	if (usedBuckets == 0) {
+		heap.push_back(entry);
+		std::push_heap(heap.begin(), heap.end(), HeapComparator);
+		return;
+	}
+	buckets[static_cast<long long>(entry.key) % usedBuckets].push_back(entry);
+}
+
+SearchQueue::Entry SearchQueue::Pop() {
+	--count;
+	if (usedBuckets == 0) {
+		std::pop_heap(heap.begin(), heap.end(), HeapComparator);
+		Entry result = heap.back();
+		heap.pop_back();
+		return result;
+	}
+	SkipEmptyBuckets();
+	auto& bucket = buckets[currentKey % usedBuckets];
+	Entry result = bucket.back();
+	bucket.pop_back();
+	return result;
+}
+
+const SearchQueue::Entry& SearchQueue::Top() {
+	if (usedBuckets == 0) {
+		return heap.front();
+	}
+	SkipEmptyBuckets();
+	return buckets[currentKey % usedBuckets].back();
+}
+
+bool SearchQueue::Empty() const {
+	return count == 0;
+}
+
+void SearchQueue::SkipEmptyBuckets() {
+	while (buckets[currentKey % usedBuckets].empty()) {
+		++currentKey;
+	}
+}
+
+void SearchWorkspace::Reset(size_t verticesCount) {
+	if (labelStamps.size() < verticesCount) {
+		labelStamps.resize(verticesCount, 0);
+		settledStamps.resize(verticesCount, 0);
+		markStamps.resize(verticesCount, 0);
+		lengths.resize(verticesCount);
+		prevs.resize(verticesCount);
+	}
+	if (++generation == 0) { // stamps wrapped around
+		std::fill(labelStamps.begin(), labelStamps.end(), 0);
+		std::fill(settledStamps.begin(), settledStamps.end(), 0);
+		std::fill(markStamps.begin(), markStamps.end(), 0);
+		generation = 1;
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+class SearchQueue { // min queue for graph searches, keeps its memory between searches
+public:
+	struct Entry {
+		int idx;
+		int prev;
+		double key;
+	};
+	void Reset(size_t bucketsCount); // 0 selects binary heap, otherwise keys must be integral and never exceed last popped key by bucketsCount or more
+	void Push(const Entry& entry);
+	Entry Pop();
+	const Entry& Top();
+	bool Empty() const;
+private:
+	void SkipEmptyBuckets();
+	std::vector<Entry> heap;
+	std::vector<std::vector<Entry>> buckets; // Dial's circular buckets, key % size
+	size_t usedBuckets = 0;
+	long long currentKey = 0;
+	size_t count = 0;
+};
+
+class SearchWorkspace { // per thread scratch space for graph searches, labels are dropped in O(1) by bumping generation
+public:
+	void Reset(size_t verticesCount); // starts new search, all vertices unreached, unsettled and unmarked
+	bool IsReached(int idx) const { return labelStamps[idx] == generation; }
+	double GetLength(int idx) const { return IsReached(idx) ? lengths[idx] : -1; }
+	int GetPrev(int idx) const { return IsReached(idx) ? prevs[idx] : -1; }
+	void SetLabel(int idx, int prev, double length) { labelStamps[idx] = generation; prevs[idx] = prev; lengths[idx] = length; }
+	bool IsSettled(int idx) const { return settledStamps[idx] == generation; }
+	void Settle(int idx) { settledStamps[idx] = generation; }
+	bool IsMarked(int idx) const { return markStamps[idx] == generation; } // free per search flag
+	void Mark(int idx) { markStamps[idx] = generation; }
+	SearchQueue queue;
+private:
+	uint32_t generation = 0; // stamps equal to 0 are never valid
+	std::vector<uint32_t> labelStamps;
+	std::vector<uint32_t> settledStamps;
+	std::vector<uint32_t> markStamps;
+	std::vector<double> lengths;
+	std::vector<int> prevs;
+};
@@ -1,5 +1,6 @@
 #include "ServerConnection.h"
 #include "json.h"
+#include "NetworkLog.h"
 #include <sstream>
 #include <random>
 
@@ -16,6 +17,11 @@
 
 constexpr char SERVER_ADDRESS[] = "wgforge-srv.wargaming.net";
 constexpr Uint16 SERVER_PORT = 443;
+constexpr Uint32 POLL_TIMEOUT = 5; // ms, batches queued meanwhile are written after it
+constexpr size_t RECEIVE_CHUNK = 1 << 16;
+
+NetworkLog* ServerConnection::networkLog = nullptr;
+std::atomic<int> ServerConnection::connectionsCount{ 0 };
 
 std::string generatePassword(std::string name) {
 	while (name.size() < 2) {
@@ -30,6 +36,7 @@ std::string generatePassword(std::string name) {
 }
 
 ServerConnection::ServerConnection(const std::string& playerName, int playerCount, const std::string& gameName, int numTurns, bool isStrong) {
+	logIdx = connectionsCount++;
 	this->isStrong = isStrong;
 	isOriginal = isStrong;
 	EstablishConnection();
@@ -48,14 +55,14 @@ ServerConnection::ServerConnection(const std::string& playerName, int playerCoun
 	req += "}";
 	SendMessage(Request::LOGIN, req);
 
-	std::stringstream responseStream = std::stringstream(GetResponse());
-	Json::Dict responseDocument = Json::Load(responseStream).GetRoot().AsMap();
+	Json::Dict responseDocument = Json::Load(GetResponse()).GetRoot().AsMap();
 	playerIdx = responseDocument["idx"].AsString();
 	auto home = responseDocument["home"].AsMap();
 	homeIdx = home["idx"].AsInt();
 }
 
 ServerConnection::ServerConnection(const std::string& playerName, const std::string& playerPassword, const std::string& gameName, bool isStrong, bool toEstablish) {
+	logIdx = connectionsCount++;
 	this->isEstablished = toEstablish;
 	this->isStrong = isStrong;
 	isOriginal = isStrong;
@@ -68,8 +75,7 @@ ServerConnection::ServerConnection(const std::string& playerName, const std::str
 	EstablishConnection();
 	SendMessage(Request::LOGIN, "{\"name\":\"" + login + "\", \"password\":\"" + password + "\"}");
 
-	std::stringstream responseStream = std::stringstream(GetResponse());
-	Json::Dict responseDocument = Json::Load(responseStream).GetRoot().AsMap();
+	Json::Dict responseDocument = Json::Load(GetResponse()).GetRoot().AsMap();
 	playerIdx = responseDocument["idx"].AsString();
 	auto home = responseDocument["home"].AsMap();
 	homeIdx = home["idx"].AsInt();
@@ -85,7 +91,10 @@ ServerConnection::ServerConnection(ServerConnection&& other) noexcept {
 	isOriginal = other.isOriginal;
 	isEstablished = other.isEstablished;
 	gameName = other.gameName;
+	logIdx = other.logIdx;
+	replayed = std::move(other.replayed);
 	other.isOriginal = false;
+	other.isEstablished = false; // socket belongs to this object now
 }
 
 int ServerConnection::GetHomeIdx() {
@@ -123,8 +132,7 @@ void ServerConnection::Establish() {
 	EstablishConnection();
 	isEstablished = true;
 	SendMessage(Request::LOGIN, "{\"name\":\"" + login + "\", \"password\":\"" + password + "\", \"game\":\"" + gameName + "\"}");
-	std::stringstream responseStream = std::stringstream(GetResponse());
-	Json::Dict responseDocument = Json::Load(responseStream).GetRoot().AsMap();
+	Json::Dict responseDocument = Json::Load(GetResponse()).GetRoot().AsMap();
 	playerIdx = responseDocument["idx"].AsString();
 	auto home = responseDocument["home"].AsMap();
 	homeIdx = home["idx"].AsInt();
@@ -145,20 +153,13 @@ std::string ServerConnection::GetMapCoordinates() {
 	return GetResponse();
 }
 
-void ServerConnection::MoveTrain(size_t lineIdx, int speed, size_t trainIdx) {
-	SendMessage(ServerConnection::Request::MOVE, 
-		"{\"line_idx\": " + std::to_string(lineIdx) +
+static std::string MakeMoveData(size_t lineIdx, int speed, size_t trainIdx) {
+	return "{\"line_idx\": " + std::to_string(lineIdx) +
 		",\"speed\": " + std::to_string(speed) +
-		", \"train_idx\": " + std::to_string(trainIdx) + "}");
-	GetResponse();
-}
-
-void ServerConnection::EndTurn() {
-	SendMessage(Request::TURN, "");
-	GetResponse();
+		", \"train_idx\": " + std::to_string(trainIdx) + "}";
 }
 
-void ServerConnection::Upgrade(std::vector<size_t> postIdxes, std::vector<size_t> trainIdxes) {
+static std::string MakeUpgradeData(const std::vector<size_t>& postIdxes, const std::vector<size_t>& trainIdxes) {
 	Json::Dict upgradeDict;
 	Json::Array posts;
 	posts.reserve(postIdxes.size());
@@ -175,25 +176,115 @@ void ServerConnection::Upgrade(std::vector<size_t> postIdxes, std::vector<size_t
 	std::stringstream out;
 	Json::Document doc{ upgradeDict };
 	Json::Print(doc, out);
-	std::string jsonRequest = out.str();
-	SendMessage(Request::UPGRADE, jsonRequest);
+	return out.str();
+}
+
+void ServerConnection::MoveTrain(size_t lineIdx, int speed, size_t trainIdx) {
+	SendMessage(ServerConnection::Request::MOVE, MakeMoveData(lineIdx, speed, trainIdx));
 	GetResponse();
 }
 
-ServerConnection::~ServerConnection() {
-	if (!isEstablished) {
-		return;
+void ServerConnection::EndTurn() {
+	SendMessage(Request::TURN, "");
+	GetResponse();
+}
+
+void ServerConnection::Upgrade(std::vector<size_t> postIdxes, std::vector<size_t> trainIdxes) {
+	SendMessage(Request::UPGRADE, MakeUpgradeData(postIdxes, trainIdxes));
+	GetResponse();
+}
+
+std::vector<ServerConnection::Response> ServerConnection::Send(const Batch& requests) {
+	return SendAsync(requests).get();
+}
+
+std::future<std::vector<ServerConnection::Response>> ServerConnection::SendAsync(Batch requests) {
+	std::promise<std::vector<Response>> promise;
+	auto future = promise.get_future();
+	if (requests.count == 0) {
+		promise.set_value({});
+		return future;
+	}
+	std::lock_guard<std::mutex> guard(ioLock);
+	if (!ioThread.joinable()) {
+		ioThread = std::thread{ &ServerConnection::RunLoop, this };
 	}
-	if (!isOriginal) {
+	pending.push_back({ std::move(requests.frames), requests.count, {}, std::move(promise) });
+	ioWake.notify_one();
+	return future;
+}
+
+void ServerConnection::Batch::MoveTrain(size_t lineIdx, int speed, size_t trainIdx) {
+	AppendMessage(frames, Request::MOVE, MakeMoveData(lineIdx, speed, trainIdx));
+	++count;
+}
+
+void ServerConnection::Batch::EndTurn() {
+	AppendMessage(frames, Request::TURN, "");
+	++count;
+}
+
+void ServerConnection::Batch::Upgrade(const std::vector<size_t>& postIdxes, const std::vector<size_t>& trainIdxes) {
+	AppendMessage(frames, Request::UPGRADE, MakeUpgradeData(postIdxes, trainIdxes));
+	++count;
+}
+
+void ServerConnection::Batch::GetMapDynamicObjects() {
+	AppendMessage(frames, Request::MAP, "{\"layer\":1}");
+	++count;
+}
+
+size_t ServerConnection::Batch::Size() const {
+	return count;
+}
+
+ServerConnection::~ServerConnection() {
+	StopLoop();
+	if (!isEstablished || IsReplaying()) {
 		return;
 	}
 	if (isStrong) {
+		if (!isOriginal) {
+			return;
+		}
 		SendMessage(Request::LOGOUT, "");
 	}
-	SDLNet_TCP_Close(socket);
+	SDLNet_TCP_Close(socket); // helper connections are only closed, logout is left to the strong one
+}
+
+void ServerConnection::UseLog(NetworkLog* log) {
+	networkLog = log;
+}
+
+bool ServerConnection::IsReplaying() {
+	return networkLog && networkLog->IsReplaying();
+}
+
+void ServerConnection::LogResponse(const Response& response) {
+	if (networkLog && !networkLog->IsReplaying()) {
+		networkLog->RecordResponse(logIdx, static_cast<Uint32>(response.result), response.data.data(), response.data.size());
+	}
+}
+
+template <typename Handler>
+static void ForEachFrame(const std::string& frames, Handler handler) { // handler(code, data, size) for every request in frames
+	size_t offset = 0;
+	while (offset + 8 <= frames.size()) {
+		Uint32 code = 0;
+		Uint32 size = 0;
+		for (int i = 3; i >= 0; --i) {
+			code = (code << 8) | static_cast<Uint8>(frames[offset + i]);
+			size = (size << 8) | static_cast<Uint8>(frames[offset + i + 4]);
+		}
+		handler(code, frames.data() + offset + 8, size);
+		offset += 8ull + size;
+	}
 }
 
 void ServerConnection::EstablishConnection() {
+	if (IsReplaying()) {
+		return; // no server, requests are answered from log
+	}
 	IPaddress ip;
 	if (SDLNet_ResolveHost(&ip, SERVER_ADDRESS, SERVER_PORT) == -1) {
 		throw std::runtime_error{ SDLNet_GetError() };
@@ -204,25 +295,19 @@ void ServerConnection::EstablishConnection() {
 	}
 }
 
-void ServerConnection::SendMessage(Request actionCode, const std::string& data) {
-	char* inBuf = nullptr;
-	int inBufSize = 0;
-	inBuf = new char[8 + data.size()];
-	inBufSize = 8 + data.size();
+void ServerConnection::AppendMessage(std::string& frames, Request actionCode, const std::string& data) {
 	Uint32 code = (Uint32)actionCode;
-	size_t index = 0;
-	unsigned char* frame_header = (unsigned char*)inBuf;
 #ifdef _NETWORK_DEBUG
 	std::cout << std::endl;
 	std::cout << "------send-------" << std::endl;
 	std::cout << "code: ";
 #endif
-	for (int i = 0; i < 4; ++i, ++index) {
+	for (int i = 0; i < 4; ++i) {
+		unsigned char byte = (unsigned char)(code & 0xFF);
 #ifdef _NETWORK_DEBUG
-		std::cout << std::hex << std::setw(2) << (unsigned int)(frame_header[index] = (unsigned char)(code & 0xFF)) << ' ';
-#else
-		frame_header[index] = (unsigned char)(code & 0xFF);
+		std::cout << std::hex << std::setw(2) << (unsigned int)byte << ' ';
 #endif
+		frames += (char)byte;
 		code >>= 8;
 	}
 	Uint32 size = data.size();
@@ -230,12 +315,12 @@ void ServerConnection::SendMessage(Request actionCode, const std::string& data)
 	std::cout << std::endl;
 	std::cout << "size: ";
 #endif
-	for (int i = 0; i < 4; ++i, ++index) {
+	for (int i = 0; i < 4; ++i) {
+		unsigned char byte = (unsigned char)(size & 0xFF);
 #ifdef _NETWORK_DEBUG
-		std::cout << std::hex << std::setw(2) << (unsigned int)(frame_header[index] = (unsigned char)(size & 0xFF)) << ' ';
-#else
-		frame_header[index] = (unsigned char)(size & 0xFF);
+		std::cout << std::hex << std::setw(2) << (unsigned int)byte << ' ';
 #endif
+		frames += (char)byte;
 		size >>= 8;
 	}
 #ifdef _NETWORK_DEBUG
@@ -243,17 +328,50 @@ void ServerConnection::SendMessage(Request actionCode, const std::string& data)
 	std::cout << "data: " << data;
 	std::cout << std::endl;
 #endif
-	for (int i = 0; i < data.size(); ++i, ++index) {
-		inBuf[index] = data[i];
+	frames += data;
+}
+
+void ServerConnection::SendMessage(Request actionCode, const std::string& data) {
+	WaitIdle();
+	std::string frames;
+	frames.reserve(8 + data.size());
+	AppendMessage(frames, actionCode, data);
+	SendFrames(frames);
+}
+
+void ServerConnection::SendFrames(const std::string& frames) {
+	if (IsReplaying()) {
+		ForEachFrame(frames, [this](Uint32 code, const char* data, size_t size) {
+			replayed += networkLog->Answer(code, data, size);
+		});
+		return;
 	}
-	if (SDLNet_TCP_Send(socket, inBuf, 8 + data.size()) < 8 + data.size()) {
-		delete[] inBuf;
+	if (SDLNet_TCP_Send(socket, frames.data(), frames.size()) < static_cast<int>(frames.size())) {
 		throw std::runtime_error{ SDLNet_GetError() };
 	}
-	delete[] inBuf;
+	if (networkLog) {
+		ForEachFrame(frames, [this](Uint32 code, const char* data, size_t size) {
+			networkLog->RecordRequest(logIdx, code, data, size);
+		});
+	}
 }
 
 std::string ServerConnection::GetResponse() {
+	Response response = ReadResponse();
+	if (response.result != Result::OKEY) {
+		throw std::runtime_error{ response.data };
+	}
+	return response.data;
+}
+
+ServerConnection::Response ServerConnection::ReadResponse() {
+	if (IsReplaying()) {
+		Response response;
+		if (!TakeResponse(replayed, response)) {
+			throw std::runtime_error{ "no response to read" };
+		}
+		return response;
+	}
 	Uint8 data[8];
 	{
 		size_t left = 8;
@@ -280,29 +398,7 @@ std::string ServerConnection::GetResponse() {
 	}
 	std::cout << std::endl;
 #endif
-	Result buf = Result::OKEY;
-	switch (responseCode) {
-	case 0:
-		break;
-	case 1:
-		buf = Result::BAD_COMMAND;
-		break;
-	case 2:
-		buf = Result::RESOURCE_NOT_FOUND;
-		break;
-	case 3:
-		buf = Result::ACCESS_DENIED;
-		break;
-	case 4:
-		buf = Result::INAPPROPRIATE_GAME_STATE;
-		break;
-	case 5:
-		buf = Result::TIMEOUT;
-		break;
-	case 500:
-		buf = Result::INTERNAL_SERVER_ERROR;
-		break;
-	}
+	Result buf = ToResult(responseCode);
 	Uint32 size = 0;
 	for (int i = 7; i >= 4; --i) {
 		size = (size << 8) | data[i];
@@ -330,14 +426,144 @@ std::string ServerConnection::GetResponse() {
 
 	std::string result = outBuf;
 
-	if (buf != Result::OKEY) {
 #ifdef _NETWORK_DEBUG
+	if (buf != Result::OKEY) {
 		std::cout << outBuf << std::endl;
-#endif
-		delete[] outBuf;
-		throw std::runtime_error{ result };
 	}
+#endif
 	delete[] outBuf;
 
-	return result;
-}
\ No newline at end of file
+	Response response{ buf, result };
+	LogResponse(response);
+	return response;
+}
+void ServerConnection::RunLoop() {
+	SDLNet_SocketSet sockets = nullptr;
+	if (!IsReplaying()) {
+		sockets = SDLNet_AllocSocketSet(1);
+		SDLNet_TCP_AddSocket(sockets, socket);
+	}
+	std::string inbound;
+	std::vector<char> chunk(RECEIVE_CHUNK);
+	std::unique_lock<std::mutex> guard(ioLock);
+	while (true) {
+		ioWake.wait(guard, [this]() { return ioStopping || !pending.empty(); });
+		if (pending.empty()) {
+			break;
+		}
+		try {
+			while (sentBatches < pending.size()) { // written as soon as queued, server answers in order anyway
+				const std::string& frames = pending[sentBatches++].frames;
+				guard.unlock();
+				SendFrames(frames);
+				guard.lock();
+			}
+			PendingBatch& batch = pending.front();
+			guard.unlock();
+			Response response;
+			while (batch.responses.size() < batch.count && TakeResponse(inbound, response)) {
+				LogResponse(response);
+				batch.responses.push_back(std::move(response));
+			}
+			if (batch.responses.size() < batch.count && IsReplaying()) {
+				if (replayed.empty()) {
+					throw std::runtime_error{ "no response to read" };
+				}
+				inbound += replayed; // answered when batch was written
+				replayed.clear();
+				guard.lock();
+				continue;
+			}
+			if (batch.responses.size() < batch.count) {
+				int ready = SDLNet_CheckSockets(sockets, POLL_TIMEOUT);
+				if (ready == -1) {
+					throw std::runtime_error{ SDLNet_GetError() };
+				}
+				if (ready > 0 && SDLNet_SocketReady(socket)) {
+					int got = SDLNet_TCP_Recv(socket, chunk.data(), static_cast<int>(chunk.size()));
+					if (got <= 0) {
+						throw std::runtime_error{ SDLNet_GetError() };
+					}
+					inbound.append(chunk.data(), got);
+				}
+				guard.lock();
+				continue;
+			}
+			batch.promise.set_value(std::move(batch.responses));
+			guard.lock();
+			pending.pop_front();
+			--sentBatches;
+		}
+		catch (...) { // stream is out of sync after network error, every queued batch fails
+			if (!guard.owns_lock()) {
+				guard.lock();
+			}
+			for (auto& batch : pending) {
+				batch.promise.set_exception(std::current_exception());
+			}
+			pending.clear();
+			sentBatches = 0;
+			inbound.clear();
+		}
+		if (pending.empty()) {
+			ioIdle.notify_all();
+		}
+	}
+	if (sockets) {
+		SDLNet_FreeSocketSet(sockets);
+	}
+}
+
+void ServerConnection::StopLoop() {
+	{
+		std::lock_guard<std::mutex> guard(ioLock);
+		ioStopping = true;
+	}
+	ioWake.notify_one();
+	if (ioThread.joinable()) {
+		ioThread.join();
+	}
+}
+
+void ServerConnection::WaitIdle() {
+	std::unique_lock<std::mutex> guard(ioLock);
+	ioIdle.wait(guard, [this]() { return pending.empty(); });
+}
+
+bool ServerConnection::TakeResponse(std::string& inbound, Response& response) {
+	if (inbound.size() < 8) {
+		return false;
+	}
+	Uint32 code = 0;
+	Uint32 size = 0;
+	for (int i = 3; i >= 0; --i) {
+		code = (code << 8) | static_cast<Uint8>(inbound[i]);
+		size = (size << 8) | static_cast<Uint8>(inbound[i + 4]);
+	}
+	if (inbound.size() < 8ull + size) {
+		return false;
+	}
+	response.result = ToResult(code);
+	response.data = inbound.substr(8, size);
+	inbound.erase(0, 8ull + size);
+	return true;
+}
+
+ServerConnection::Result ServerConnection::ToResult(Uint32 code) {
+	switch (code) {
+	case 1:
+		return Result::BAD_COMMAND;
+	case 2:
+		return Result::RESOURCE_NOT_FOUND;
+	case 3:
+		return Result::ACCESS_DENIED;
+	case 4:
+		return Result::INAPPROPRIATE_GAME_STATE;
+	case 5:
+		return Result::TIMEOUT;
+	case 500:
+		return Result::INTERNAL_SERVER_ERROR;
+	default:
+		return Result::OKEY;
+	}
+}
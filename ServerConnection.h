@@ -1,8 +1,16 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <deque>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <SDL_net.h>
 
+class NetworkLog;
+
 class ServerConnection { 
 protected:
 	enum class Request {
@@ -25,6 +33,7 @@ protected:
 	bool isStrong;
 	bool isOriginal;
 	bool isEstablished = true;
+	int logIdx; // tells connections apart in network log
 public:
 	enum class Result {
 		OKEY = 0,
@@ -35,6 +44,22 @@ public:
 		TIMEOUT = 5,
 		INTERNAL_SERVER_ERROR = 500
 	};
+	struct Response {
+		Result result;
+		std::string data; // error message if result is not OKEY
+	};
+	class Batch { // requests written to server back-to-back by Send, server answers them in the same order
+	public:
+		void MoveTrain(size_t lineIdx, int speed, size_t trainIdx);
+		void EndTurn();
+		void Upgrade(const std::vector<size_t>& postIdxes, const std::vector<size_t>& trainIdxes);
+		void GetMapDynamicObjects();
+		size_t Size() const;
+	private:
+		friend class ServerConnection;
+		std::string frames;
+		size_t count = 0;
+	};
 
 	ServerConnection(const std::string& playerName, int playerCount, const std::string& gameName, int numTurns = -1, bool isStrong = true);
 	ServerConnection(const std::string& playerName, const std::string& playerPassword, const std::string& gameName, bool isStrong = false, bool toEstablish = true);
@@ -56,11 +81,40 @@ public:
 	void MoveTrain(size_t lineIdx, int speed, size_t trainIdx);
 	void EndTurn();
 	void Upgrade(std::vector<size_t> postIdxes, std::vector<size_t> trainIdxes);
+	std::vector<Response> Send(const Batch& requests); // one write and one round-trip for all requests, throws only on network errors
+	std::future<std::vector<Response>> SendAsync(Batch requests); // written and answered by I/O loop of connection, batches are answered in order
 
-	~ServerConnection(); // performs logout operation
+	~ServerConnection(); // answers queued batches, then performs logout operation if strong and closes the socket
+	static void UseLog(NetworkLog* log); // every connection records its frames to log or is answered from it, set before connections are created, nullptr for network only
 private:
+	static NetworkLog* networkLog;
+	static std::atomic<int> connectionsCount;
+	std::string replayed; // responses from network log not read yet, stands for socket
+	static bool IsReplaying();
+	void LogResponse(const Response& response);
+	struct PendingBatch {
+		std::string frames;
+		size_t count;
+		std::vector<Response> responses;
+		std::promise<std::vector<Response>> promise;
+	};
+	std::thread ioThread; // started by first SendAsync, connection must not be moved after that
+	std::mutex ioLock;
+	std::condition_variable ioWake; // batch queued or loop stopping
+	std::condition_variable ioIdle; // every queued batch answered
+	std::deque<PendingBatch> pending; // front is being answered
+	size_t sentBatches = 0; // pending batches already written
+	bool ioStopping = false;
+	void RunLoop(); // writes queued batches and polls socket for their answers
+	void StopLoop();
+	void WaitIdle(); // blocking requests must not interleave with answers of batches
+	static bool TakeResponse(std::string& inbound, Response& response); // moves first complete response out of inbound
+	static Result ToResult(Uint32 code);
 	void EstablishConnection();
+	static void AppendMessage(std::string& frames, Request actionCode, const std::string& data); // encodes header and data of one request
 	void SendMessage(Request actionCode, const std::string& data);
-	std::string GetResponse();
+	void SendFrames(const std::string& frames);
+	std::string GetResponse(); // throws error message if result is not OKEY
+	Response ReadResponse();
 };
 
@@ -2,10 +2,12 @@
 #include "SDL_manager.h"
 #include "SDL_window.h"
 #include "GameWorld.h"
+#include "NetworkLog.h"
 #include <chrono>
 #include <thread>
 #include <iostream>
 #include <random>
+#include <memory>
 
 constexpr int frameTime = 33;
 constexpr int numTurns = 500;
@@ -17,31 +19,54 @@ int main(int argC, char** argV) {
 	std::string name;
 	std::string buf;
 	int playerCount = 1;
-	std::cout << "Enter player count or leave blank for default: ";
-	std::getline(std::cin, buf);
-	if (buf.empty()) {
-		std::cout << "1 assumed" << std::endl;
-		playerCount = 1;
-	}
-	else if (buf[0] >= '1' && buf[0] <= '4' && buf.size() == 1) {
-		playerCount = buf[0] - '0';
-	}
-	else {
-		std::cout << "illegal value, 1 assumed" << std::endl;
-		playerCount = 1;
+	std::string logPath; // --record <path> writes every server exchange to log, --replay <path> plays the game from log without network
+	NetworkLog::Mode logMode = NetworkLog::Mode::RECORD;
+	for (int i = 1; i + 1 < argC; i += 2) {
+		std::string option = argV[i];
+		if (option == "--record" || option == "--replay") {
+			logPath = argV[i + 1];
+			logMode = option == "--record" ? NetworkLog::Mode::RECORD : NetworkLog::Mode::REPLAY;
+		}
+		else {
+			std::cout << "unknown option " << option << " ignored" << std::endl;
+		}
 	}
-	std::cout << "Enter player name or leave blank for default: ";
-	std::getline(std::cin, name);
-	if (name.empty()) {
-		std::cout << "'team 2' assumed" << std::endl;
+	bool isReplay = !logPath.empty() && logMode == NetworkLog::Mode::REPLAY;
+	if (isReplay) { // answers come from log whatever is entered
 		name = "team 2";
 	}
-	if (playerCount > 1) {
-		std::cout << playerCount << " players game;" << std::endl;
-		std::cout << "Enter game name or leave blank for default: ";
-		std::getline(std::cin, gameName);
+	else {
+		std::cout << "Enter player count or leave blank for default: ";
+		std::getline(std::cin, buf);
+		if (buf.empty()) {
+			std::cout << "1 assumed" << std::endl;
+			playerCount = 1;
+		}
+		else if (buf[0] >= '1' && buf[0] <= '4' && buf.size() == 1) {
+			playerCount = buf[0] - '0';
+		}
+		else {
+			std::cout << "illegal value, 1 assumed" << std::endl;
+			playerCount = 1;
+		}
+		std::cout << "Enter player name or leave blank for default: ";
+		std::getline(std::cin, name);
+		if (name.empty()) {
+			std::cout << "'team 2' assumed" << std::endl;
+			name = "team 2";
+		}
+		if (playerCount > 1) {
+			std::cout << playerCount << " players game;" << std::endl;
+			std::cout << "Enter game name or leave blank for default: ";
+			std::getline(std::cin, gameName);
+		}
 	}
 	try {
+		std::unique_ptr<NetworkLog> networkLog; // outlives connections of world
+		if (!logPath.empty()) {
+			networkLog = std::make_unique<NetworkLog>(logPath, logMode);
+			ServerConnection::UseLog(networkLog.get());
+		}
 		SdlManager manager{};
 		SdlWindow window{ "graph demo", 1280, 960 };
 		TextureManager textureManager = window.CreateTextureManager();
@@ -49,7 +74,8 @@ int main(int argC, char** argV) {
 		bool toExit = false;
 		auto lastUpdateTime = std::chrono::high_resolution_clock::now();
 
-		std::thread updateThread{ [&world, &toExit]() {
+		std::thread updateThread{ [&world, &toExit, &networkLog, isReplay]() {
+			auto start = std::chrono::high_resolution_clock::now();
 			try {
 #ifndef _DEBUG
 				int turn = 0;
@@ -63,6 +89,10 @@ int main(int argC, char** argV) {
 						world.Update();
 					}
 					catch (const std::runtime_error& e) {
+						if (isReplay) { // log has no answers left
+							std::cout << e.what() << std::endl;
+							break;
+						}
 #ifndef _DEBUG
 						std::cout << e.what() << std::endl;
 						--turn;
@@ -75,6 +105,11 @@ int main(int argC, char** argV) {
 					std::cout << "score: " << world.GetScore() << std::endl;
 #endif
 				}
+				if (isReplay) {
+					auto finish = std::chrono::high_resolution_clock::now();
+					std::cout << "replayed " << networkLog->GetRecordedSeconds() << "s of recorded game in "
+						<< std::chrono::duration_cast<std::chrono::milliseconds>(finish - start).count() << "ms" << std::endl;
+				}
 			}
 			catch (const std::runtime_error& error) {
 				std::cout << "got unexpected error: " << error.what() << std::endl;
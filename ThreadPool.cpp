@@ -0,0 +1,69 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <utility>
+
+ThreadPool::ThreadPool(unsigned threadsCount) {
+	for (unsigned i = 1; i < std::max(1u, threadsCount); ++i) {
+		workers.emplace_back(&ThreadPool::Work, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::Run(size_t tasksCount, const std::function<void(size_t)>& task) {
+	std::unique_lock<std::mutex> guard(lock);
+	batch = &task;
+	this->tasksCount = tasksCount;
+	nextTask = 0;
+	unfinished = tasksCount;
+	error = nullptr;
+	wake.notify_all();
+	RunTasks(guard);
+	done.wait(guard, [this]() { return unfinished == 0; });
+	batch = nullptr;
+	if (error) {
+		std::rethrow_exception(std::exchange(error, nullptr));
+	}
+}
+
+void ThreadPool::Work() {
+	std::unique_lock<std::mutex> guard(lock);
+	while (true) {
+		wake.wait(guard, [this]() { return stopping || (batch && nextTask < tasksCount); });
+		if (stopping) {
+			return;
+		}
+		RunTasks(guard);
+	}
+}
+
+void ThreadPool::RunTasks(std::unique_lock<std::mutex>& guard) {
+	while (batch && nextTask < tasksCount) {
+		size_t idx = nextTask++;
+		const auto& task = *batch;
+		guard.unlock();
+		std::exception_ptr failure;
+		try {
+			task(idx);
+		}
+		catch (...) {
+			failure = std::current_exception();
+		}
+		guard.lock();
+		if (failure && !error) {
+			error = failure;
+		}
+		if (--unfinished == 0) {
+			done.notify_all();
+		}
+	}
+}
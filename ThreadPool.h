@@ -0,0 +1,29 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+class ThreadPool { // fixed set of workers running one batch of indexed tasks at a time
+public:
+	explicit ThreadPool(unsigned threadsCount = std::thread::hardware_concurrency()); // caller of Run counts as one of threads
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	~ThreadPool();
+	void Run(size_t tasksCount, const std::function<void(size_t)>& task); // calls task(i) for every i < tasksCount, returns when all are done, rethrows first error
+private:
+	void Work();
+	void RunTasks(std::unique_lock<std::mutex>& guard); // takes tasks of current batch until none are left
+	std::vector<std::thread> workers;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const std::function<void(size_t)>* batch = nullptr;
+	size_t tasksCount = 0;
+	size_t nextTask = 0;
+	size_t unfinished = 0;
+	std::exception_ptr error;
+	bool stopping = false;
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include <atomic>
+
+// Hands values over from one writer thread to one reader thread without locks. Writer fills own back buffer and swaps it
+// with the middle one, reader swaps own front buffer with the middle one when it holds a value not taken yet.
+template <typename T>
+class TripleBuffer {
+public:
+	TripleBuffer() = default;
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+	T& GetBack(); // writer only, keeps some older value, so containers reuse their memory
+	void Publish(); // writer only, back buffer becomes the latest value
+	const T& GetFront(); // reader only, latest published value, valid until next call
+private:
+	static constexpr unsigned FRESH = 4; // set in middle while it holds value reader has not taken
+	T buffers[3];
+	unsigned back = 0;
+	unsigned front = 1;
+	std::atomic<unsigned> middle{ 2 };
+};
+
+template <typename T>
+T& TripleBuffer<T>::GetBack() {
+	return buffers[back];
+}
+
+template <typename T>
+void TripleBuffer<T>::Publish() {
+	back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+}
+
+template <typename T>
+const T& TripleBuffer<T>::GetFront() {
+	if (middle.load(std::memory_order_relaxed) & FRESH) {
+		front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+	}
+	return buffers[front];
+}
@@ -1,182 +1,688 @@
 #include "graph.h"
 #include "json.h"
+#include "SearchWorkspace.h"
 #include <cmath>
 #include <fstream>
 #include <sstream>
-#include <queue>
+#include <limits>
+#include <algorithm>
 
 constexpr double PI = 3.141592653589793238463;
 constexpr double X_MIDDLE = 400;
 constexpr double Y_MIDDLE = 300;
 constexpr double R = std::min(X_MIDDLE - 30, Y_MIDDLE - 30);
+constexpr size_t LANDMARKS_COUNT = 8;
+constexpr size_t MAX_BUCKETS = 1 << 16; // longest edge for which bucket queue is used
+
+static SearchWorkspace& GetWorkspace(int side = 0) { // bidirectional search needs one workspace per side
+	static thread_local SearchWorkspace workspaces[2];
+	return workspaces[side];
+}
 
 Graph::Graph(const std::string& filename) {
 	std::ifstream in(filename);
-	ParseStructure(in);
+	std::stringstream ss;
+	ss << in.rdbuf();
+	ParseStructure(ss.str());
+	spTrees.resize(adjacencyList.size());
+	spTreesFilled = std::vector<std::once_flag>(adjacencyList.size());
+	ComputeHeuristicScale();
+	SelectLandmarks(LANDMARKS_COUNT);
 }
 
 Graph::Graph(const std::string& jsonStructureData, const std::string& jsonCoordinatesData) {
-	{
-		std::stringstream ss;
-		ss << jsonStructureData;
-		ParseStructure(ss);
-	}
-	{
-		std::stringstream ss;
-		ss << jsonCoordinatesData;
-		ParseCoordinates(ss);
-	}
+	ParseStructure(jsonStructureData);
+	ParseCoordinates(jsonCoordinatesData);
 	spTrees.resize(adjacencyList.size());
+	spTreesFilled = std::vector<std::once_flag>(adjacencyList.size());
+	ComputeHeuristicScale();
+	SelectLandmarks(LANDMARKS_COUNT);
 }
 
 int Graph::TranslateVertexIdx(size_t idx) const {
-	return idxConverter.at(idx);
+	return idxConverter.Translate(idx);
 }
 
 int Graph::GetEdgeIdx(int from, int to) const {
-	for (const auto& i : adjacencyList[from].edges) {
-		if (i.to == to) {
-			return i.idx;
-		}
-	}
-	return 0;
+	int slot = FindEdgeSlot(from, to);
+	return slot == -1 ? 0 : edgesIdx[slot];
 }
 
 double Graph::GetDistance(int from, int to) const {
 	if (from == to) {
 		return 0.0;
 	}
-	if (spTrees[from].empty()) {
-		spTrees[from] = GenerateSpTree(from);
+	if (!distanceMatrix.empty()) {
+		return distanceMatrix[from * adjacencyList.size() + to];
 	}
-	return spTrees[from][to].length;
+	return GetFullSpTree(from)[to].length;
 }
 
-std::optional<double> Graph::GetDistance(int from, int to, const std::unordered_set<int>& verticesBlackList, const std::unordered_set<edge>& edgesBlackList, int dist, int onPathTo) const {
-	auto blackList = verticesBlackList;
-	if (blackList.count(to)) {
-		blackList.erase(to);
+int Graph::GetNextOnPath(int from, int to) const {
+	if (from == to) {
+		return to;
 	}
-	if (blackList.count(from)) {
-		blackList.erase(from);
+	if (!nextHopMatrix.empty()) {
+		return nextHopMatrix[from * adjacencyList.size() + to];
 	}
-	auto ans = GenerateSpTree(from, blackList, edgesBlackList);
-	if (dist != 0 && edgesBlackList.count({ from, onPathTo }) == 0) {
-		auto buf = GenerateSpTree(onPathTo, verticesBlackList, edgesBlackList);
-		if (ans[to].length != -1) {
-			ans[to].length += dist;
+	const std::vector<spData>& tree = GetFullSpTree(from);
+	if (tree[to].length == -1) {
+		return -1;
+	}
+	return GetNextOnPath(tree, from, to);
+}
+
+const std::vector<Graph::spData>& Graph::GetFullSpTree(int origin) const {
+	std::call_once(spTreesFilled[origin], [this, origin]() {
+		spTrees[origin] = GenerateSpTree(origin, BlackList{});
+	});
+	return spTrees[origin];
+}
+
+void Graph::PrecomputeDistances(unsigned threadsCount) {
+	size_t n = adjacencyList.size();
+	std::vector<double> distances(n * n);
+	std::vector<int> nextHops(n * n);
+	std::atomic<size_t> nextOrigin = 0;
+	auto worker = [&]() {
+		std::vector<int> stack;
+		std::vector<spData> tree;
+		for (size_t origin = nextOrigin++; origin < n; origin = nextOrigin++) {
+			GenerateSpTree(static_cast<int>(origin), BlackList{}, tree);
+			double* distanceRow = distances.data() + origin * n;
+			int* nextHopRow = nextHops.data() + origin * n;
+			for (size_t i = 0; i < n; ++i) {
+				distanceRow[i] = tree[i].length;
+				nextHopRow[i] = -2; // not resolved yet
+			}
+			nextHopRow[origin] = static_cast<int>(origin);
+			for (size_t i = 0; i < n; ++i) {
+				int cur = static_cast<int>(i);
+				while (nextHopRow[cur] == -2) {
+					if (tree[cur].length == -1) {
+						nextHopRow[cur] = -1;
+					}
+					else if (tree[cur].prevVertex == static_cast<int>(origin)) {
+						nextHopRow[cur] = cur;
+					}
+					else {
+						stack.push_back(cur);
+						cur = tree[cur].prevVertex;
+					}
+				}
+				for (int j : stack) {
+					nextHopRow[j] = nextHopRow[cur];
+				}
+				stack.clear();
+			}
 		}
-		double edgeLen = 0;
-		for (const auto& edge : adjacencyList[from].edges) {
-			if (edge.to == onPathTo) {
-				edgeLen = edge.length;
-				break;
+	};
+	threadsCount = std::max(1u, threadsCount);
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < threadsCount; ++i) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	distanceMatrix = std::move(distances);
+	nextHopMatrix = std::move(nextHops);
+	spTrees.clear();
+	spTrees.shrink_to_fit();
+	spTreesFilled.clear();
+}
+
+std::optional<double> Graph::GetDistance(int from, int to, const BitSet& verticesBlackList, const BitSet& edgesBlackList, int dist, int onPathTo) const {
+	if (auto path = FindPath(from, to, verticesBlackList, edgesBlackList, dist, onPathTo)) {
+		return path->length;
+	}
+	return std::nullopt;
+}
+
+std::optional<int> Graph::GetNextOnPath(int from, int to, const BitSet& verticesBlackList, const BitSet& edgesBlackList, int dist, int onPathTo) const {
+	if (from == to) {
+		return to;
+	}
+	if (searchMode != SearchMode::SP_TREE) {
+		return FindNextOnPath(from, to, verticesBlackList, edgesBlackList, dist, onPathTo);
+	}
+	if (auto path = FindPath(from, to, verticesBlackList, edgesBlackList, dist, onPathTo)) {
+		return GetNextOnPath(path->tree, from, to);
+	}
+	return std::nullopt;
+}
+
+std::vector<std::optional<double>> Graph::GetDistances(int from, const std::vector<int>& targets, const BitSet& verticesBlackList, const BitSet& edgesBlackList, int dist, int onPathTo) const {
+	auto search = [&](int origin, bool first) { // first search excepts from and targets from black list as GetDistance does
+		if (targets.size() == 1) {
+			std::optional<PointPath> path = GetPointPath(origin, targets[0], first ? MakeBlackList(verticesBlackList, edgesBlackList, from, targets[0]) : MakeBlackList(verticesBlackList, edgesBlackList));
+			return std::vector<double>{ path ? path->length : -1 };
+		}
+		return SweepDistances(origin, targets, first ? MakeBlackList(verticesBlackList, edgesBlackList, from) : MakeBlackList(verticesBlackList, edgesBlackList), first);
+	};
+	std::vector<double> lengths = search(from, true);
+	if (dist != 0 && !IsEdgeBlackListed(edgesBlackList, from, onPathTo)) {
+		std::vector<double> buf = search(onPathTo, false);
+		int slot = FindEdgeSlot(from, onPathTo);
+		double edgeLen = slot == -1 ? 0 : edgesLength[slot];
+		for (size_t i = 0; i < targets.size(); ++i) {
+			if (lengths[i] != -1) {
+				lengths[i] += dist;
+			}
+			if (buf[i] != -1) {
+				buf[i] += edgeLen - dist;
+			}
+			if ((lengths[i] == -1) || ((buf[i] != -1) && (buf[i] < lengths[i]))) {
+				lengths[i] = buf[i];
 			}
 		}
-		if (buf[to].length != -1) {
-			buf[to].length += edgeLen - dist;
+	}
+	std::vector<std::optional<double>> result(targets.size());
+	for (size_t i = 0; i < targets.size(); ++i) {
+		if (lengths[i] != -1) {
+			result[i] = lengths[i];
 		}
-		if ((ans[to].length == -1) || ((buf[to].length != -1) && (buf[to].length < ans[to].length))) {
+	}
+	return result;
+}
+
+void Graph::SetSearchMode(SearchMode mode) {
+	searchMode = mode;
+}
+
+std::optional<Graph::PathData> Graph::FindPath(int from, int to, const BitSet& verticesBlackList, const BitSet& edgesBlackList, int dist, int onPathTo) const {
+	PathData ans{ GenerateSpTree(from, MakeBlackList(verticesBlackList, edgesBlackList, from, to)), 0.0 };
+	ans.length = ans.tree[to].length;
+	if (dist != 0 && !IsEdgeBlackListed(edgesBlackList, from, onPathTo)) {
+		PathData buf{ GenerateSpTree(onPathTo, MakeBlackList(verticesBlackList, edgesBlackList)), 0.0 };
+		buf.length = buf.tree[to].length;
+		if (ans.length != -1) {
+			ans.length += dist;
+		}
+		int slot = FindEdgeSlot(from, onPathTo);
+		double edgeLen = slot == -1 ? 0 : edgesLength[slot];
+		if (buf.length != -1) {
+			buf.length += edgeLen - dist;
+		}
+		if ((ans.length == -1) || ((buf.length != -1) && (buf.length < ans.length))) {
 			ans = std::move(buf);
 		}
 	}
-	if (ans[to].length == -1) {
+	if (ans.length == -1) {
 		return std::nullopt;
 	}
-	return ans[to].length;
+	return ans;
 }
 
-std::optional<int> Graph::GetNextOnPath(int from, int to, const std::unordered_set<int>& verticesBlackList, const std::unordered_set<edge>& edgesBlackList, int dist, int onPathTo) const {
-	if (from == to) {
-		return to;
+static int GetNextOnPath(const std::vector<int>& path, int from) { // same walk as on shortest path tree
+	for (size_t i = path.size() - 1; i > 0; --i) {
+		if (path[i - 1] == from) {
+			return path[i];
+		}
+	}
+	return path[0];
+}
+
+std::optional<int> Graph::FindNextOnPath(int from, int to, const BitSet& verticesBlackList, const BitSet& edgesBlackList, int dist, int onPathTo) const {
+	std::optional<PointPath> ans = GetPointPath(from, to, MakeBlackList(verticesBlackList, edgesBlackList, from, to));
+	if (dist != 0 && !IsEdgeBlackListed(edgesBlackList, from, onPathTo)) {
+		std::optional<PointPath> buf = GetPointPath(onPathTo, to, MakeBlackList(verticesBlackList, edgesBlackList));
+		if (ans) {
+			ans->length += dist;
+		}
+		int slot = FindEdgeSlot(from, onPathTo);
+		double edgeLen = slot == -1 ? 0 : edgesLength[slot];
+		if (buf) {
+			buf->length += edgeLen - dist;
+		}
+		if (!ans || (buf && buf->length < ans->length)) {
+			ans = std::move(buf);
+		}
 	}
-	auto blackList = verticesBlackList;
-	if (blackList.count(to)) {
-		blackList.erase(to);
+	if (!ans) {
+		return std::nullopt;
 	}
-	if (blackList.count(from)) {
-		blackList.erase(from);
+	return ::GetNextOnPath(ans->vertices, from);
+}
+
+std::optional<Graph::PointPath> Graph::GetPointPath(int origin, int target, const BlackList& blackList) const {
+	if (searchMode == SearchMode::BIDIRECTIONAL) {
+		return BidirectionalSearch(origin, target, blackList);
 	}
-	auto ans = GenerateSpTree(from, blackList, edgesBlackList);
-	if (dist != 0 && edgesBlackList.count({ from, onPathTo }) == 0) {
-		auto buf = GenerateSpTree(onPathTo, verticesBlackList, edgesBlackList);
-		if (ans[to].length != -1) {
-			ans[to].length += dist;
+	return AStarSearch(origin, target, blackList);
+}
+
+// Dijkstra that stops once all targets are settled. With targetsExcepted black listed targets may be reached
+// but are never passed through, which gives the same lengths as separate searches excepting every target.
+std::vector<double> Graph::SweepDistances(int origin, const std::vector<int>& targets, const BlackList& blackList, bool targetsExcepted) const {
+	std::vector<double> result(targets.size(), -1);
+	SearchWorkspace& workspace = GetWorkspace();
+	workspace.Reset(adjacencyList.size());
+	auto isForbidden = [&](int idx) {
+		return idx != origin && blackList.vertices.Contains(idx);
+	};
+	size_t remaining = 0;
+	for (int target : targets) {
+		remaining += !workspace.IsMarked(target);
+		workspace.Mark(target);
+	}
+	SearchQueue& dijkstra = workspace.queue;
+	dijkstra.Reset(bucketsCount);
+	dijkstra.Push({ origin, -1, 0 });
+	while (!dijkstra.Empty() && remaining != 0) {
+		SearchQueue::Entry cur = dijkstra.Pop();
+		if (workspace.IsReached(cur.idx) || (isForbidden(cur.idx) && !(targetsExcepted && workspace.IsMarked(cur.idx)))) {
+			continue;
+		}
+		workspace.SetLabel(cur.idx, cur.prev, cur.key);
+		remaining -= workspace.IsMarked(cur.idx);
+		if (isForbidden(cur.idx)) {
+			continue;
+		}
+		for (size_t e = edgesOffset[cur.idx]; e < edgesOffset[cur.idx + 1]; ++e) {
+			if (!workspace.IsReached(edgesTo[e]) && !blackList.edges.Contains(static_cast<int>(e))) {
+				dijkstra.Push({ edgesTo[e], cur.idx, cur.key + edgesLength[e] });
+			}
+		}
+	}
+	for (size_t i = 0; i < targets.size(); ++i) {
+		result[i] = workspace.GetLength(targets[i]);
+	}
+	return result;
+}
+
+void Graph::ComputeHeuristicScale() {
+	heuristicScale = std::numeric_limits<double>::infinity();
+	for (size_t i = 0; i < adjacencyList.size(); ++i) {
+		for (size_t e = edgesOffset[i]; e < edgesOffset[i + 1]; ++e) {
+			const Vertex::Point& a = adjacencyList[i].point;
+			const Vertex::Point& b = adjacencyList[edgesTo[e]].point;
+			double euclid = std::hypot(a.x - b.x, a.y - b.y);
+			if (euclid > 0) {
+				heuristicScale = std::min(heuristicScale, edgesLength[e] / euclid);
+			}
 		}
-		double edgeLen = 0;
-		for (const auto& edge : adjacencyList[from].edges) {
-			if (edge.to == onPathTo) {
-				edgeLen = edge.length;
+	}
+	if (!std::isfinite(heuristicScale)) {
+		heuristicScale = 0.0;
+	}
+	heuristicScale *= 1 - 1e-9; // keeps heuristic admissible despite rounding
+}
+
+// Farthest point selection: every next landmark is the vertex farthest from already chosen ones,
+// vertices unreachable from all of them come first so every component gets a landmark.
+void Graph::SelectLandmarks(size_t count) {
+	size_t n = adjacencyList.size();
+	landmarksCount = std::min(count, n);
+	landmarkDistances.assign(n * landmarksCount, -1);
+	if (landmarksCount == 0) {
+		return;
+	}
+	std::vector<double> nearest(n, -1); // distance to closest chosen landmark, -1 if unreachable from all
+	std::vector<spData> tree;
+	GenerateSpTree(0, BlackList{}, tree);
+	for (size_t i = 0; i < n; ++i) {
+		nearest[i] = tree[i].length;
+	}
+	for (size_t l = 0; l < landmarksCount; ++l) {
+		int landmark = 0;
+		for (size_t i = 0; i < n; ++i) {
+			if (nearest[landmark] == -1) {
 				break;
 			}
+			if (nearest[i] == -1 || nearest[i] > nearest[landmark]) {
+				landmark = static_cast<int>(i);
+			}
 		}
-		if (buf[to].length != -1) {
-			buf[to].length += edgeLen - dist;
+		GenerateSpTree(landmark, BlackList{}, tree);
+		for (size_t i = 0; i < n; ++i) {
+			landmarkDistances[i * landmarksCount + l] = tree[i].length;
+			if (l == 0 || (tree[i].length != -1 && (nearest[i] == -1 || tree[i].length < nearest[i]))) {
+				nearest[i] = tree[i].length;
+			}
 		}
-		if ((ans[to].length == -1) || ((buf[to].length != -1) && (buf[to].length < ans[to].length))) {
-			ans = std::move(buf);
+	}
+}
+
+double Graph::GetDistanceLowerBound(int from, int to) const {
+	if (from == to) {
+		return 0.0;
+	}
+	if (!distanceMatrix.empty()) {
+		return std::max(0.0, distanceMatrix[from * adjacencyList.size() + to]);
+	}
+	const Vertex::Point& a = adjacencyList[from].point;
+	const Vertex::Point& b = adjacencyList[to].point;
+	double result = heuristicScale * std::hypot(a.x - b.x, a.y - b.y);
+	const double* fromRow = landmarkDistances.data() + from * landmarksCount;
+	const double* toRow = landmarkDistances.data() + to * landmarksCount;
+	for (size_t l = 0; l < landmarksCount; ++l) {
+		if (fromRow[l] != -1 && toRow[l] != -1) {
+			result = std::max(result, std::abs(fromRow[l] - toRow[l]));
+		}
+	}
+	return result;
+}
+
+double Graph::GetDistanceLowerBound(int from, int to, const BitSet& edgesBlackList, int dist, int onPathTo) const {
+	double result = GetDistanceLowerBound(from, to);
+	if (dist != 0 && !IsEdgeBlackListed(edgesBlackList, from, onPathTo)) {
+		int slot = FindEdgeSlot(from, onPathTo);
+		double edgeLen = slot == -1 ? 0 : edgesLength[slot];
+		result = std::min(result + dist, GetDistanceLowerBound(onPathTo, to) + edgeLen - dist);
+	}
+	return result;
+}
+
+double Graph::GetDistanceUpperBound(int from, int to) const {
+	if (from == to) {
+		return 0.0;
+	}
+	if (!distanceMatrix.empty()) {
+		double result = distanceMatrix[from * adjacencyList.size() + to];
+		return result == -1 ? std::numeric_limits<double>::infinity() : result;
+	}
+	double result = std::numeric_limits<double>::infinity();
+	const double* fromRow = landmarkDistances.data() + from * landmarksCount;
+	const double* toRow = landmarkDistances.data() + to * landmarksCount;
+	for (size_t l = 0; l < landmarksCount; ++l) {
+		if (fromRow[l] != -1 && toRow[l] != -1) {
+			result = std::min(result, fromRow[l] + toRow[l]);
 		}
 	}
-	if (ans[to].length == -1) {
+	return result;
+}
+
+// A* with heuristic from GetDistanceLowerBound, black lists work as in GenerateSpTree
+std::optional<Graph::PointPath> Graph::AStarSearch(int origin, int target, const BlackList& blackList) const {
+	if (target != origin && blackList.vertices.Contains(target)) {
 		return std::nullopt;
 	}
-	return GetNextOnPath(ans, from, to);
+	SearchWorkspace& workspace = GetWorkspace();
+	workspace.Reset(adjacencyList.size());
+	SearchQueue& aStar = workspace.queue;
+	aStar.Reset(0); // estimates are not integral
+	workspace.SetLabel(origin, -1, 0);
+	aStar.Push({ origin, -1, GetDistanceLowerBound(origin, target) });
+	while (!aStar.Empty()) {
+		int cur = aStar.Pop().idx;
+		if (workspace.IsSettled(cur)) {
+			continue;
+		}
+		if (cur == target) {
+			PointPath result{ {}, workspace.GetLength(target) };
+			for (int i = target; i != -1; i = workspace.GetPrev(i)) {
+				result.vertices.push_back(i);
+			}
+			std::reverse(result.vertices.begin(), result.vertices.end());
+			return result;
+		}
+		workspace.Settle(cur);
+		for (size_t e = edgesOffset[cur]; e < edgesOffset[cur + 1]; ++e) {
+			int next = edgesTo[e];
+			double length = workspace.GetLength(cur) + edgesLength[e];
+			if (workspace.IsSettled(next) || (next != origin && blackList.vertices.Contains(next)) || (workspace.IsReached(next) && workspace.GetLength(next) <= length) ||
+				blackList.edges.Contains(static_cast<int>(e))) {
+				continue;
+			}
+			workspace.SetLabel(next, cur, length);
+			aStar.Push({ next, cur, length + GetDistanceLowerBound(next, target) });
+		}
+	}
+	return std::nullopt;
+}
+
+// Dijkstra from both ends, backward search walks edges in reverse so directed edge black list is checked on reverse slot
+std::optional<Graph::PointPath> Graph::BidirectionalSearch(int origin, int target, const BlackList& blackList) const {
+	if (origin == target) {
+		return PointPath{ { origin }, 0.0 };
+	}
+	if (blackList.vertices.Contains(target)) {
+		return std::nullopt;
+	}
+	SearchWorkspace* workspaces[2] = { &GetWorkspace(0), &GetWorkspace(1) }; // forward, backward
+	workspaces[0]->Reset(adjacencyList.size());
+	workspaces[1]->Reset(adjacencyList.size());
+	workspaces[0]->queue.Reset(bucketsCount);
+	workspaces[1]->queue.Reset(bucketsCount);
+	workspaces[0]->SetLabel(origin, -1, 0);
+	workspaces[1]->SetLabel(target, -1, 0);
+	workspaces[0]->queue.Push({ origin, -1, 0 });
+	workspaces[1]->queue.Push({ target, -1, 0 });
+	double best = -1;
+	int meeting = -1;
+	while (!workspaces[0]->queue.Empty() && !workspaces[1]->queue.Empty()) {
+		double forwardKey = workspaces[0]->queue.Top().key;
+		double backwardKey = workspaces[1]->queue.Top().key;
+		if (best != -1 && forwardKey + backwardKey >= best) {
+			break;
+		}
+		int side = forwardKey <= backwardKey ? 0 : 1;
+		SearchWorkspace& cur = *workspaces[side];
+		SearchWorkspace& other = *workspaces[1 - side];
+		int idx = cur.queue.Pop().idx;
+		if (cur.IsSettled(idx)) {
+			continue;
+		}
+		cur.Settle(idx);
+		for (size_t e = edgesOffset[idx]; e < edgesOffset[idx + 1]; ++e) {
+			int next = edgesTo[e];
+			double length = cur.GetLength(idx) + edgesLength[e];
+			int directed = side == 0 ? static_cast<int>(e) : edgesReverse[e];
+			if (cur.IsSettled(next) || (next != origin && blackList.vertices.Contains(next)) || (cur.IsReached(next) && cur.GetLength(next) <= length) ||
+				blackList.edges.Contains(directed)) {
+				continue;
+			}
+			cur.SetLabel(next, idx, length);
+			cur.queue.Push({ next, idx, length });
+			if (other.IsReached(next) && (best == -1 || length + other.GetLength(next) < best)) {
+				best = length + other.GetLength(next);
+				meeting = next;
+			}
+		}
+	}
+	if (meeting == -1) {
+		return std::nullopt;
+	}
+	PointPath result{ {}, best };
+	for (int i = meeting; i != -1; i = workspaces[0]->GetPrev(i)) {
+		result.vertices.push_back(i);
+	}
+	std::reverse(result.vertices.begin(), result.vertices.end());
+	for (int i = workspaces[1]->GetPrev(meeting); i != -1; i = workspaces[1]->GetPrev(i)) {
+		result.vertices.push_back(i);
+	}
+	return result;
 }
 
 std::pair<int, int> Graph::GetEdgeVertices(int originalEdgeIdx) const {
-	return edgesData.at(originalEdgeIdx);
+	const EdgeData& data = GetEdgeData(originalEdgeIdx);
+	return { data.from, data.to };
 }
 
 double Graph::GetEdgeLength(int originalEdgeIdx) const {
-	for (const auto& j : adjacencyList[GetEdgeVertices(originalEdgeIdx).first].edges) {
-		if (j.idx == originalEdgeIdx) {
-			return j.length;
+	return GetEdgeData(originalEdgeIdx).length;
+}
+
+std::vector<int> Graph::GetEdgeIdxs() const {
+	std::vector<int> result;
+	for (size_t i = 0; i < edgesData.size(); ++i) {
+		if (edgesData[i].from != -1) {
+			result.push_back(static_cast<int>(i));
 		}
 	}
-	return 0.0;
+	return result;
+}
+
+const Graph::EdgeData& Graph::GetEdgeData(int originalEdgeIdx) const {
+	if (originalEdgeIdx < 0 || originalEdgeIdx >= static_cast<int>(edgesData.size()) || edgesData[originalEdgeIdx].from == -1) {
+		throw std::out_of_range{ "no edge with such idx" };
+	}
+	return edgesData[originalEdgeIdx];
+}
+
+bool Graph::IsEdgeBlackListed(const BitSet& edgesBlackList, int from, int to) const {
+	int slot = FindEdgeSlot(from, to);
+	return slot != -1 && edgesBlackList.Contains(slot);
+}
+
+BitSet Graph::MakeVertexSet() const {
+	return BitSet(adjacencyList.size());
+}
+
+BitSet Graph::MakeEdgeSet() const {
+	return BitSet(edgesTo.size());
+}
+
+void Graph::InsertEdge(BitSet& edgesBlackList, int from, int to) const {
+	for (size_t e = edgesOffset[from]; e < edgesOffset[from + 1]; ++e) {
+		if (edgesTo[e] == to) {
+			edgesBlackList.Insert(static_cast<int>(e));
+		}
+	}
+}
+
+std::pair<int, int> Graph::GetEdgeSlotVertices(int slot) const {
+	return { edgesFrom[slot], edgesTo[slot] };
+}
+
+std::pair<int, int> Graph::GetEdgeSlots(int vertex) const {
+	return { static_cast<int>(edgesOffset[vertex]), static_cast<int>(edgesOffset[vertex + 1]) };
+}
+
+int Graph::GetEdgeSlotIdx(int slot) const {
+	return edgesIdx[slot];
+}
+
+size_t Graph::GetVerticesCount() const {
+	return adjacencyList.size();
+}
+
+int Graph::FindEdgeSlot(int from, int to) const {
+	uint64_t key = static_cast<uint64_t>(from) << 32 | static_cast<uint32_t>(to);
+	size_t mask = edgeSlotKeys.size() - 1;
+	for (size_t i = MixHash(key) & mask; edgeSlotValues[i] != -1; i = (i + 1) & mask) {
+		if (edgeSlotKeys[i] == key) {
+			return edgeSlotValues[i];
+		}
+	}
+	return -1;
 }
 
 std::pair<double, double> Graph::GetPointCoord(int localPointIdx) const {
 	return std::pair<double, double>{adjacencyList[localPointIdx].point.x, adjacencyList[localPointIdx].point.y};
 }
 
-void Graph::AddEdge(size_t from, Vertex::Edge edge) {
-	auto pos = std::find_if(begin(adjacencyList[from].edges), end(adjacencyList[from].edges), [edge](const Vertex::Edge& cur) {return cur.to < edge.to; });
-	if (pos == end(adjacencyList[from].edges)) {
-		adjacencyList[from].edges.push_back(edge);
-	} else {
-		adjacencyList[from].edges.insert(pos, edge);
+void Graph::AddEdge(std::vector<Vertex::Edge>& edges, Vertex::Edge edge) {
+	auto pos = std::find_if(begin(edges), end(edges), [edge](const Vertex::Edge& cur) {return cur.to < edge.to; });
+	edges.insert(pos, edge);
+}
+
+void Graph::BuildEdgeTables() {
+	size_t capacity = 1;
+	while (capacity < 2 * edgesTo.size() + 1) {
+		capacity <<= 1;
+	}
+	edgeSlotKeys.assign(capacity, 0);
+	edgeSlotValues.assign(capacity, -1);
+	for (size_t from = 0; from + 1 < edgesOffset.size(); ++from) {
+		for (size_t e = edgesOffset[from]; e < edgesOffset[from + 1]; ++e) {
+			uint64_t key = static_cast<uint64_t>(from) << 32 | static_cast<uint32_t>(edgesTo[e]);
+			size_t i = MixHash(key) & (capacity - 1);
+			while (edgeSlotValues[i] != -1 && edgeSlotKeys[i] != key) {
+				i = (i + 1) & (capacity - 1);
+			}
+			if (edgeSlotValues[i] == -1) { // parallel edges keep the first one, as the scans did
+				edgeSlotKeys[i] = key;
+				edgeSlotValues[i] = static_cast<int>(e);
+			}
+		}
+	}
+	edgesFrom.resize(edgesTo.size());
+	edgesReverse.resize(edgesTo.size());
+	for (size_t from = 0; from + 1 < edgesOffset.size(); ++from) {
+		for (size_t e = edgesOffset[from]; e < edgesOffset[from + 1]; ++e) {
+			edgesFrom[e] = static_cast<int>(from);
+			int to = edgesTo[e];
+			size_t rank = 0; // k-th parallel edge is paired with k-th edge back
+			for (size_t i = edgesOffset[from]; i < e; ++i) {
+				rank += edgesTo[i] == to;
+			}
+			for (size_t i = edgesOffset[to]; i < edgesOffset[to + 1]; ++i) {
+				if (edgesTo[i] == static_cast<int>(from) && rank-- == 0) {
+					edgesReverse[e] = static_cast<int>(i);
+					break;
+				}
+			}
+		}
 	}
 }
 
-std::vector<Graph::spData> Graph::GenerateSpTree(int origin, const std::unordered_set<int>& verticesBlackList, const std::unordered_set<edge>& edgesBlackList) const {
-	std::vector <spData> ans(adjacencyList.size(), { -1, -1 });
-	struct dijkstraData {
-		int idx;
-		int prev;
-		double length;
-	};
-	auto comparator = [](const dijkstraData& lhs, const dijkstraData& rhs) {return lhs.length > rhs.length; };
-	std::priority_queue<dijkstraData, std::vector<dijkstraData>, decltype(comparator)> dijkstra(comparator);
-	dijkstra.push({ origin, -1, 0 });
-	for (size_t i = 0; i < adjacencyList.size(); i++) {
-		dijkstraData cur = { origin, -1, 0 };
-		while (((ans[cur.idx].length != -1) || ((verticesBlackList.count(cur.idx) != 0) && (cur.idx != origin)) || 
-			(edgesBlackList.count(std::make_pair(cur.prev, cur.idx)))) && (!dijkstra.empty())) {
-			cur = dijkstra.top();
-			dijkstra.pop();
-		}
-		if (dijkstra.empty()) {
+void Graph::BuildAdjacency(const std::vector<std::vector<Vertex::Edge>>& edges) {
+	edgesOffset.assign(1, 0);
+	edgesOffset.reserve(edges.size() + 1);
+	for (const auto& vertexEdges : edges) {
+		edgesOffset.push_back(edgesOffset.back() + vertexEdges.size());
+	}
+	edgesTo.clear();
+	edgesLength.clear();
+	edgesIdx.clear();
+	edgesTo.reserve(edgesOffset.back());
+	edgesLength.reserve(edgesOffset.back());
+	edgesIdx.reserve(edgesOffset.back());
+	for (const auto& vertexEdges : edges) {
+		for (const auto& edge : vertexEdges) {
+			edgesTo.push_back(static_cast<int>(edge.to));
+			edgesLength.push_back(edge.length);
+			edgesIdx.push_back(static_cast<int>(edge.idx));
+		}
+	}
+	bucketsCount = static_cast<size_t>(maxLength) + 1;
+	for (double length : edgesLength) {
+		if (length < 0 || length != std::floor(length) || maxLength >= MAX_BUCKETS) {
+			bucketsCount = 0;
 			break;
 		}
-		ans[cur.idx] = { cur.prev, cur.length };
-		for (const auto& edge : adjacencyList[cur.idx].edges) {
-			if (ans[edge.to].length == -1) {
-				dijkstra.push({ static_cast<int>(edge.to), cur.idx, ans[cur.idx].length + edge.length });
+	}
+}
+
+std::vector<Graph::spData> Graph::GenerateSpTree(int origin, const BlackList& blackList) const {
+	std::vector<spData> ans;
+	GenerateSpTree(origin, blackList, ans);
+	return ans;
+}
+
+void Graph::GenerateSpTree(int origin, const BlackList& blackList, std::vector<spData>& ans) const {
+	ans.assign(adjacencyList.size(), { -1, -1 });
+	SearchQueue& dijkstra = GetWorkspace().queue;
+	dijkstra.Reset(bucketsCount);
+	dijkstra.Push({ origin, -1, 0 });
+	while (!dijkstra.Empty()) {
+		SearchQueue::Entry cur = dijkstra.Pop();
+		if ((ans[cur.idx].length != -1) || (blackList.vertices.Contains(cur.idx) && (cur.idx != origin))) {
+			continue;
+		}
+		ans[cur.idx] = { cur.prev, cur.key };
+		for (size_t e = edgesOffset[cur.idx]; e < edgesOffset[cur.idx + 1]; ++e) {
+			if (ans[edgesTo[e]].length == -1 && !blackList.edges.Contains(static_cast<int>(e))) {
+				dijkstra.Push({ edgesTo[e], cur.idx, cur.key + edgesLength[e] });
 			}
 		}
 	}
-	return ans;
+}
+
+
+
+const Graph::BlackList& Graph::MakeBlackList(const BitSet& verticesBlackList, const BitSet& edgesBlackList, int exceptA, int exceptB) const {
+	static thread_local BlackList result; // assignment reuses memory of previous query
+	result.vertices = verticesBlackList;
+	result.edges = edgesBlackList;
+	result.vertices.Resize(adjacencyList.size());
+	result.edges.Resize(edgesTo.size());
+	result.vertices.Erase(exceptA);
+	result.vertices.Erase(exceptB);
+	return result;
 }
 
 int Graph::GetNextOnPath(const std::vector<spData>& spTree, int from, int to) const {
@@ -189,54 +695,143 @@ int Graph::GetNextOnPath(const std::vector<spData>& spTree, int from, int to) co
 
 void Graph::DrawEdges(SdlWindow& window) {
 	for (int i = 0; i < adjacencyList.size(); ++i) {
-		for (const auto& j : adjacencyList[i].edges) {
-			if (j.to < i) {
+		for (size_t e = edgesOffset[i]; e < edgesOffset[i + 1]; ++e) {
+			if (edgesTo[e] < i) {
 				break;
 			}
 			window.SetDrawColor(255, 255, 255);
-			window.DrawLine(std::round(adjacencyList[i].point.x), std::round(adjacencyList[i].point.y), std::round(adjacencyList[j.to].point.x), std::round(adjacencyList[j.to].point.y));
+			window.DrawLine(std::round(adjacencyList[i].point.x), std::round(adjacencyList[i].point.y), std::round(adjacencyList[edgesTo[e]].point.x), std::round(adjacencyList[edgesTo[e]].point.y));
 		}
 	}
 }
 
-void Graph::ParseStructure(std::istream& input) {
-	Json::Document document = Json::Load(input);
-	auto nodeMap = document.GetRoot().AsMap();
-	adjacencyList.reserve(nodeMap["points"].AsArray().size());
-	double phi = 0;
-	double phi_step = 2 * PI / nodeMap["points"].AsArray().size();
-	for (const auto& vertexNode : nodeMap["points"].AsArray()) {
-		auto vertexMap = vertexNode.AsMap();
-		idxConverter[vertexMap["idx"].AsInt()] = adjacencyList.size();
-		adjacencyList.push_back({ static_cast<size_t>(vertexMap["idx"].AsInt()), std::nullopt, std::list<Vertex::Edge>(),
-			{X_MIDDLE + R * std::cos(phi), Y_MIDDLE + R * std::sin(phi)} });
-		if (!vertexMap["post_idx"].IsNull()) {
-			adjacencyList.back().postIdx = static_cast<size_t>(vertexMap["post_idx"].AsInt());
+void Graph::ParseStructure(std::string_view input) {
+	struct LineData {
+		int idx = 0;
+		int points[2] = { 0, 0 };
+		double length = 0.0;
+	};
+	std::vector<LineData> lines;
+	Json::Reader reader(input);
+	reader.ReadDict([&](std::string_view key) {
+		if (key == "points") {
+			reader.ReadArray([&]() {
+				Vertex vertex{ 0, std::nullopt, {0.0, 0.0} };
+				reader.ReadDict([&](std::string_view key) {
+					if (key == "idx") {
+						vertex.originalIdx = static_cast<size_t>(reader.ReadInt());
+					}
+					else if (key == "post_idx" && reader.PeekType() != Json::Reader::Type::NULL_VALUE) {
+						vertex.postIdx = static_cast<size_t>(reader.ReadInt());
+					}
+					else {
+						reader.Skip();
+					}
+				});
+				idxConverter.Add(vertex.originalIdx, static_cast<int>(adjacencyList.size()));
+				adjacencyList.push_back(std::move(vertex));
+			});
+		}
+		else if (key == "lines") { // lines may precede points, so they are translated afterwards
+			reader.ReadArray([&]() {
+				LineData& line = lines.emplace_back();
+				reader.ReadDict([&](std::string_view key) {
+					if (key == "idx") {
+						line.idx = reader.ReadInt();
+					}
+					else if (key == "length") {
+						line.length = reader.ReadDouble();
+					}
+					else if (key == "points") {
+						int i = 0;
+						reader.ReadArray([&]() {
+							if (i < 2) {
+								line.points[i++] = reader.ReadInt();
+							}
+							else {
+								reader.Skip();
+							}
+						});
+					}
+					else {
+						reader.Skip();
+					}
+				});
+			});
 		}
+		else {
+			reader.Skip();
+		}
+	});
+	double phi = 0;
+	double phi_step = 2 * PI / adjacencyList.size();
+	for (auto& vertex : adjacencyList) {
+		vertex.point = { X_MIDDLE + R * std::cos(phi), Y_MIDDLE + R * std::sin(phi) };
 		phi += phi_step;
 	}
-	for (const auto& edgeNode : nodeMap["lines"].AsArray()) {
-		auto edgeMap = edgeNode.AsMap();
-		size_t from = TranslateVertexIdx(edgeMap["points"].AsArray()[0].AsInt());
-		Vertex::Edge edge(edgeMap["idx"].AsInt(), TranslateVertexIdx(edgeMap["points"].AsArray()[1].AsInt()), edgeMap["length"].AsDouble());
-		edgesData[edge.idx] = { from, edge.to };
-		AddEdge(from, edge);
+	std::vector<int> endpoints(lines.size() * 2);
+	for (size_t i = 0; i < lines.size(); ++i) {
+		endpoints[2 * i] = lines[i].points[0];
+		endpoints[2 * i + 1] = lines[i].points[1];
+	}
+	idxConverter.Translate(endpoints.data(), endpoints.data(), endpoints.size()); // in place
+	std::vector<std::vector<Vertex::Edge>> edges(adjacencyList.size());
+	for (size_t i = 0; i < lines.size(); ++i) {
+		const LineData& line = lines[i];
+		size_t from = endpoints[2 * i];
+		Vertex::Edge edge(line.idx, endpoints[2 * i + 1], line.length);
+		if (edge.idx >= edgesData.size()) {
+			edgesData.resize(edge.idx + 1);
+		}
+		edgesData[edge.idx] = { static_cast<int>(from), static_cast<int>(edge.to), edge.length };
+		AddEdge(edges[from], edge);
 		std::swap(from, edge.to);
-		AddEdge(from, edge);
+		AddEdge(edges[from], edge);
 		maxLength = std::max(maxLength, edge.length);
 	}
+	BuildAdjacency(edges);
+	BuildEdgeTables();
 }
 
-void Graph::ParseCoordinates(std::istream& input) {
-	Json::Document document = Json::Load(input);
-	auto nodeMap = document.GetRoot().AsMap();
-	for (const auto& node : nodeMap["coordinates"].AsArray()) {
-		auto coordMap = node.AsMap();
-		size_t curIdx = TranslateVertexIdx(coordMap["idx"].AsInt());
-		adjacencyList[curIdx].point.x = coordMap["x"].AsDouble();
-		adjacencyList[curIdx].point.y = coordMap["y"].AsDouble();
-	}
-	auto sizeArray = nodeMap["size"].AsArray();
-	width = sizeArray[0].AsDouble();
-	height = sizeArray[1].AsDouble();
+void Graph::ParseCoordinates(std::string_view input) {
+	Json::Reader reader(input);
+	reader.ReadDict([&](std::string_view key) {
+		if (key == "coordinates") {
+			reader.ReadArray([&]() {
+				int idx = 0;
+				Vertex::Point point{ 0.0, 0.0 };
+				reader.ReadDict([&](std::string_view key) {
+					if (key == "idx") {
+						idx = reader.ReadInt();
+					}
+					else if (key == "x") {
+						point.x = reader.ReadDouble();
+					}
+					else if (key == "y") {
+						point.y = reader.ReadDouble();
+					}
+					else {
+						reader.Skip();
+					}
+				});
+				adjacencyList[TranslateVertexIdx(idx)].point = point;
+			});
+		}
+		else if (key == "size") {
+			int i = 0;
+			reader.ReadArray([&]() {
+				double value = reader.ReadDouble();
+				if (i == 0) {
+					width = value;
+				}
+				else if (i == 1) {
+					height = value;
+				}
+				++i;
+			});
+		}
+		else {
+			reader.Skip();
+		}
+	});
 }
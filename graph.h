@@ -1,19 +1,20 @@
 #pragma once
 #include <vector>
-#include <list>
 #include <mutex>
 #include <optional>
 #include <atomic>
-#include <map>
-#include <unordered_set>
+#include <string_view>
+#include <thread>
 #include "SDL_window.h"
+#include "IdRemap.h"
+#include "BitSet.h"
+#include "FlatHash.h"
 
 namespace std {
     template <> 
     struct hash<std::pair<int, int>> {
         inline size_t operator()(const std::pair<int, int>& v) const {
-            std::hash<int> int_hasher;
-            return int_hasher(v.first) ^ int_hasher(v.second);
+            return MixHash(v.first, v.second);
         }
     };
 }
@@ -33,41 +34,108 @@ protected:
         };
         size_t originalIdx;
         std::optional<size_t> postIdx;
-        std::list<Edge> edges;
         Point point;
     };
     std::vector<Vertex> adjacencyList;
+    // compressed sparse row adjacency built once after parsing:
+    // edges of vertex v are [edgesOffset[v], edgesOffset[v + 1]) sorted by descending target
+    std::vector<size_t> edgesOffset;
+    std::vector<int> edgesTo;
+    std::vector<double> edgesLength;
+    std::vector<int> edgesIdx;
+    std::vector<int> edgesFrom;
+    std::vector<int> edgesReverse; // CSR slot of the same edge in opposite direction
     double maxLength = 0;
+    size_t bucketsCount = 0; // bucket queue width if all edge lengths are small integers, 0 selects binary heap
     std::mutex writeLock;
-    std::map<size_t, size_t> idxConverter;
-    std::map<size_t, std::pair<size_t, size_t>> edgesData;
+    IdRemap idxConverter; // server point idx -> local vertex idx
+    struct EdgeData {
+        int from = -1; // -1 if there is no edge with such idx
+        int to = -1;
+        double length = 0.0;
+    };
+    std::vector<EdgeData> edgesData; // indexed by original edge idx
+    std::vector<uint64_t> edgeSlotKeys; // open addressing table (from, to) -> CSR slot, power of two size
+    std::vector<int> edgeSlotValues;
     struct spData {
         int prevVertex;
         double length;
     };
-    mutable std::vector<std::vector<spData>> spTrees;
+    mutable std::vector<std::vector<spData>> spTrees; // filled lazily when matrices are not precomputed
+    mutable std::vector<std::once_flag> spTreesFilled; // per origin, planning threads may ask for the same tree
+    std::vector<double> distanceMatrix; // row per origin, empty if not precomputed
+    std::vector<int> nextHopMatrix; // first vertex after origin on shortest path, -1 if unreachable
     double width;
     double height;
 public:
     using edge = std::pair<int, int>;
+    enum class SearchMode { SP_TREE, ASTAR, BIDIRECTIONAL }; // how black listed GetNextOnPath looks for a path
     explicit Graph(const std::string& filename); // creates graph with points in circular layout from file with json data
     Graph(const std::string& jsonStructureData, const std::string& jsonCoordinatesData);
     int TranslateVertexIdx(size_t idx) const;
     int GetEdgeIdx(int from, int to) const;
+    BitSet MakeVertexSet() const; // empty vertices black list
+    BitSet MakeEdgeSet() const; // empty directed edges black list, indexed by edge slot
+    void InsertEdge(BitSet& edgesBlackList, int from, int to) const; // black lists every edge from -> to
+    std::pair<int, int> GetEdgeSlotVertices(int slot) const; // from-to pair of edge set element
+    std::pair<int, int> GetEdgeSlots(int vertex) const; // [begin, end) of edge slots going out of vertex
+    int GetEdgeSlotIdx(int slot) const; // original idx of edge in slot
+    size_t GetVerticesCount() const;
     double GetDistance(int from, int to) const;
-    std::optional<double> GetDistance(int from, int to, const std::unordered_set<int>& verticesBlackList, const std::unordered_set<edge>& edgesBlackList, int dist = 0, int onPathTo = -1) const; // no caching
-    std::optional<int> GetNextOnPath(int from, int to, const std::unordered_set<int>& verticesBlackList, const std::unordered_set<edge>& edgesBlackList, int dist = 0, int onPathTo = -1) const; // no caching
+    int GetNextOnPath(int from, int to) const; // first vertex on unrestricted shortest path, -1 if unreachable
+    void PrecomputeDistances(unsigned threadsCount = std::thread::hardware_concurrency()); // fills distance and next hop matrices in parallel
+    std::optional<double> GetDistance(int from, int to, const BitSet& verticesBlackList, const BitSet& edgesBlackList, int dist = 0, int onPathTo = -1) const; // no caching
+    std::optional<int> GetNextOnPath(int from, int to, const BitSet& verticesBlackList, const BitSet& edgesBlackList, int dist = 0, int onPathTo = -1) const; // no caching
+    std::vector<std::optional<double>> GetDistances(int from, const std::vector<int>& targets, const BitSet& verticesBlackList, const BitSet& edgesBlackList, int dist = 0, int onPathTo = -1) const; // same as GetDistance for every target, one search per origin
+    void SetSearchMode(SearchMode mode);
+    double GetDistanceLowerBound(int from, int to) const; // never exceeds distance with any black lists
+    double GetDistanceLowerBound(int from, int to, const BitSet& edgesBlackList, int dist, int onPathTo) const; // bound for black listed GetDistance with same arguments
+    double GetDistanceUpperBound(int from, int to) const; // bound for unrestricted distance, infinity if unknown
     std::pair<int, int> GetEdgeVertices(int originalEdgeIdx) const; // returns local from-to idx pair
     double GetEdgeLength(int originalEdgeIdx) const; // returns length of edge
+    std::vector<int> GetEdgeIdxs() const; // original idx of every edge
     std::pair<double, double> GetPointCoord(int localPointIdx) const; // returns x-y pair
     virtual void Draw(SdlWindow& window) = 0; // draws current graph
     void DrawEdges(SdlWindow& window);
     virtual ~Graph() = default;
 private:
-    void ParseStructure(std::istream& input);
-    void ParseCoordinates(std::istream& input);
-    void AddEdge(size_t from, Vertex::Edge edge);
+    void ParseStructure(std::string_view input);
+    void ParseCoordinates(std::string_view input);
+    static void AddEdge(std::vector<Vertex::Edge>& edges, Vertex::Edge edge);
+    void BuildAdjacency(const std::vector<std::vector<Vertex::Edge>>& edges);
+    void BuildEdgeTables();
+    int FindEdgeSlot(int from, int to) const; // CSR slot of directed edge, -1 if absent
+    bool IsEdgeBlackListed(const BitSet& edgesBlackList, int from, int to) const;
+    const EdgeData& GetEdgeData(int originalEdgeIdx) const; // throws std::out_of_range for unknown idx
     int GetNextOnPath(const std::vector<spData>& spTree, int from, int to) const;
-    std::vector<spData> GenerateSpTree(int origin, const std::unordered_set<int>& verticesBlackList = {}, const std::unordered_set<edge>& edgesBlackList = {}) const;
+    void ComputeHeuristicScale();
+    void SelectLandmarks(size_t count);
+    std::vector<double> landmarkDistances; // landmarksCount values per vertex, -1 if unreachable
+    size_t landmarksCount = 0;
+    SearchMode searchMode = SearchMode::ASTAR;
+    double heuristicScale = 0.0; // lower bound of edge length per unit of euclidean distance, 0 disables heuristic
+
+    struct BlackList { // black lists resized to graph
+        BitSet vertices;
+        BitSet edges;
+    };
+    struct PathData {
+        std::vector<spData> tree;
+        double length;
+    };
+    struct PointPath {
+        std::vector<int> vertices; // from origin to target
+        double length;
+    };
+    const BlackList& MakeBlackList(const BitSet& verticesBlackList, const BitSet& edgesBlackList, int exceptA = -1, int exceptB = -1) const; // per thread, valid until next call on the same thread
+    std::optional<PathData> FindPath(int from, int to, const BitSet& verticesBlackList, const BitSet& edgesBlackList, int dist, int onPathTo) const;
+    std::vector<spData> GenerateSpTree(int origin, const BlackList& blackList) const;
+    const std::vector<spData>& GetFullSpTree(int origin) const; // tree without black lists, built on first use
+    void GenerateSpTree(int origin, const BlackList& blackList, std::vector<spData>& ans) const; // reuses ans memory
+    std::optional<int> FindNextOnPath(int from, int to, const BitSet& verticesBlackList, const BitSet& edgesBlackList, int dist, int onPathTo) const;
+    std::optional<PointPath> GetPointPath(int origin, int target, const BlackList& blackList) const;
+    std::vector<double> SweepDistances(int origin, const std::vector<int>& targets, const BlackList& blackList, bool targetsExcepted) const; // -1 if unreachable
+    std::optional<PointPath> AStarSearch(int origin, int target, const BlackList& blackList) const;
+    std::optional<PointPath> BidirectionalSearch(int origin, int target, const BlackList& blackList) const;
 };
 
@@ -154,6 +154,246 @@ namespace Json {
         return Document{LoadNode(input)};
     }
 
+    void Reader::SkipSpaces() {
+        while (cur != end && isspace(static_cast<unsigned char>(*cur))) {
+            ++cur;
+        }
+    }
+
+    char Reader::Get() {
+        SkipSpaces();
+        if (cur == end) {
+            throw std::invalid_argument("Ill-formed JSON");
+        }
+        return *cur++;
+    }
+
+    void Reader::ReadWord(string_view word) {
+        SkipSpaces();
+        if (static_cast<size_t>(end - cur) < word.size() || string_view(cur, word.size()) != word) {
+            throw std::invalid_argument("Ill-formed JSON");
+        }
+        cur += word.size();
+    }
+
+    Reader::Type Reader::PeekType() {
+        SkipSpaces();
+        if (cur == end) {
+            return Type::NONE;
+        }
+        switch (*cur) {
+        case '[':
+            return Type::ARRAY;
+        case '{':
+            return Type::DICT;
+        case '"':
+            return Type::STRING;
+        case 't':
+        case 'f':
+            return Type::BOOL;
+        case 'n':
+            return Type::NULL_VALUE;
+        default:
+            if (*cur == '-' || isdigit(static_cast<unsigned char>(*cur))) {
+                return Type::NUMBER;
+            }
+            return Type::NONE;
+        }
+    }
+
+    void Reader::BeginArray() {
+        if (Get() != '[') {
+            throw std::invalid_argument("Ill-formed JSON");
+        }
+    }
+
+    bool Reader::NextElement() {
+        SkipSpaces();
+        if (cur == end) {
+            throw std::invalid_argument("Ill-formed JSON");
+        }
+        if (*cur == ']') {
+            ++cur;
+            return false;
+        }
+        if (*cur == ',') {
+            ++cur;
+        }
+        return true;
+    }
+
+    void Reader::BeginDict() {
+        if (Get() != '{') {
+            throw std::invalid_argument("Ill-formed JSON");
+        }
+    }
+
+    bool Reader::NextKey(string_view& key) {
+        char c = Get();
+        if (c == '}') {
+            return false;
+        }
+        if (c == ',') {
+            c = Get();
+        }
+        if (c != '"') {
+            throw std::invalid_argument("Ill-formed JSON");
+        }
+        --cur;
+        key = ReadString();
+        if (Get() != ':') {
+            throw std::invalid_argument("Ill-formed JSON");
+        }
+        return true;
+    }
+
+    string_view Reader::ReadString() {
+        if (Get() != '"') {
+            throw std::invalid_argument("Ill-formed JSON");
+        }
+        const char* begin = cur;
+        while (cur != end && *cur != '"') {
+            if (*cur == '\\' && cur + 1 != end) {
+                ++cur;
+            }
+            ++cur;
+        }
+        if (cur == end) {
+            throw std::invalid_argument("Ill-formed JSON");
+        }
+        return string_view(begin, cur++ - begin);
+    }
+
+    bool Reader::ReadBool() {
+        if (PeekType() != Type::BOOL) {
+            throw std::invalid_argument("Ill-formed JSON");
+        }
+        if (*cur == 't') {
+            ReadWord("true");
+            return true;
+        }
+        ReadWord("false");
+        return false;
+    }
+
+    void Reader::ReadNull() {
+        ReadWord("null");
+    }
+
+    std::variant<int, double> Reader::ReadNumber() {
+        Type type = PeekType();
+        if (type == Type::NULL_VALUE) {
+            ReadNull();
+            return 0;
+        }
+        if (type != Type::NUMBER) {
+            throw std::invalid_argument("Ill-formed JSON");
+        }
+        bool isNegative = false;
+        if (*cur == '-') {
+            isNegative = true;
+            ++cur;
+        }
+        int intPart = 0;
+        while (cur != end && isdigit(static_cast<unsigned char>(*cur))) {
+            intPart *= 10;
+            intPart += *cur++ - '0';
+        }
+        if (cur == end || *cur != '.') {
+            return intPart * (isNegative ? -1 : 1);
+        }
+        ++cur;  // '.'
+        double result = intPart;
+        double fracMult = 0.1;
+        while (cur != end && isdigit(static_cast<unsigned char>(*cur))) {
+            result += fracMult * (*cur++ - '0');
+            fracMult /= 10;
+        }
+        return result * (isNegative ? -1 : 1);
+    }
+
+    int Reader::ReadInt() {
+        auto number = ReadNumber();
+        return holds_alternative<int>(number) ? get<int>(number) : static_cast<int>(get<double>(number));
+    }
+
+    double Reader::ReadDouble() {
+        auto number = ReadNumber();
+        return holds_alternative<int>(number) ? get<int>(number) : get<double>(number);
+    }
+
+    void Reader::Skip() {
+        string_view key;
+        switch (PeekType()) {
+        case Type::ARRAY:
+            BeginArray();
+            while (NextElement()) {
+                Skip();
+            }
+            break;
+        case Type::DICT:
+            BeginDict();
+            while (NextKey(key)) {
+                Skip();
+            }
+            break;
+        case Type::STRING:
+            ReadString();
+            break;
+        case Type::BOOL:
+            ReadBool();
+            break;
+        case Type::NULL_VALUE:
+            ReadNull();
+            break;
+        case Type::NUMBER:
+            ReadNumber();
+            break;
+        default:
+            throw std::invalid_argument("Ill-formed JSON");
+        }
+    }
+
+    Node LoadNode(Reader& input) {
+        switch (input.PeekType()) {
+        case Reader::Type::ARRAY:
+        {
+            Array result;
+            input.BeginArray();
+            while (input.NextElement()) {
+                result.push_back(LoadNode(input));
+            }
+            return Node(move(result));
+        }
+        case Reader::Type::DICT:
+        {
+            Dict result;
+            string_view key;
+            input.BeginDict();
+            while (input.NextKey(key)) {
+                result.emplace(string(key), LoadNode(input));
+            }
+            return Node(move(result));
+        }
+        case Reader::Type::STRING:
+            return Node(string(input.ReadString()));
+        case Reader::Type::BOOL:
+            return Node(input.ReadBool());
+        case Reader::Type::NULL_VALUE:
+            input.ReadNull();
+            return Node(0);
+        case Reader::Type::NUMBER:
+            return visit([](auto value) { return Node(value); }, input.ReadNumber());
+        default:
+            throw std::invalid_argument("Ill-formed JSON");
+        }
+    }
+
+    Document Load(string_view input) {
+        Reader reader(input);
+        return Document{LoadNode(reader)};
+    }
+
     template<>
     void PrintValue<string>(const string& value, ostream& output) {
         output << '"';
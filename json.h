@@ -2,6 +2,7 @@
 #include <iostream>
 #include <map>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -65,10 +66,84 @@ namespace Json {
         const Node& GetRoot() const;
     };
 
+    // Single-pass pull parser over a contiguous buffer.
+    // Strings are returned as views into the source buffer (escape sequences are not decoded),
+    // so the buffer must outlive every view obtained from the reader.
+    // As in LoadNode, null is read as 0 by the number accessors.
+    class Reader {
+    public:
+        enum class Type {
+            NONE,
+            ARRAY,
+            DICT,
+            BOOL,
+            NUMBER,
+            STRING,
+            NULL_VALUE
+        };
+
+        explicit Reader(std::string_view input) : cur{ input.data() }, end{ input.data() + input.size() } {}
+
+        Type PeekType();
+
+        void BeginArray();
+
+        bool NextElement(); // consumes separator, returns false after closing bracket
+
+        void BeginDict();
+
+        bool NextKey(std::string_view& key); // consumes separator, key and colon, returns false after closing brace
+
+        std::string_view ReadString();
+
+        bool ReadBool();
+
+        int ReadInt();
+
+        double ReadDouble();
+
+        std::variant<int, double> ReadNumber();
+
+        void ReadNull();
+
+        void Skip(); // skips next value with all nested values
+
+        template<typename KeyHandler>
+        void ReadDict(KeyHandler onKey) { // onKey(key) must read or skip the value
+            std::string_view key;
+            BeginDict();
+            while (NextKey(key)) {
+                onKey(key);
+            }
+        }
+
+        template<typename ElementHandler>
+        void ReadArray(ElementHandler onElement) { // onElement() must read or skip the element
+            BeginArray();
+            while (NextElement()) {
+                onElement();
+            }
+        }
+
+    private:
+        void SkipSpaces();
+
+        char Get();
+
+        void ReadWord(std::string_view word);
+
+        const char* cur;
+        const char* end;
+    };
+
     Node LoadNode(std::istream& input);
 
+    Node LoadNode(Reader& input);
+
     Document Load(std::istream& input);
 
+    Document Load(std::string_view input);
+
     void PrintNode(const Node& node, std::ostream& output);
 
     template<typename Value>